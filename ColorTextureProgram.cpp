@@ -1,56 +1,51 @@
 #include "ColorTextureProgram.hpp"
 
-#include "gl_compile_program.hpp"
+#include "GLStateCache.hpp"
 #include "gl_errors.hpp"
+#include "Packfile.hpp"
+
+#include <stdexcept>
+
+ProgramPermutations &ColorTextureProgram::permutations() {
+	//NOTE: never deleted on purpose -- programs go away with the context, which outlives this
+	static ProgramPermutations *permutations = [](){
+		//shader sources live in the asset packfile (see assets/shaders/):
+		if (!Packfile::assets) {
+			throw std::runtime_error("ColorTextureProgram needs Packfile::assets to be loaded first.");
+		}
+		return new ProgramPermutations(
+			Packfile::assets->get("shaders/color_texture.vert").as_string(),
+			Packfile::assets->get("shaders/color_texture.frag").as_string(),
+			{ "TEXTURED", "INSTANCED", "SDF" } //in the same order as the feature bits
+		);
+	}();
+	return *permutations;
+}
 
-ColorTextureProgram::ColorTextureProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
-		//vertex shader:
-		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"in vec4 Position;\n"
-		"in vec4 Color;\n"
-		"in vec2 TexCoord;\n"
-		"out vec4 color;\n"
-		"out vec2 texCoord;\n"
-		"void main() {\n"
-		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
-		"	color = Color;\n"
-		"	texCoord = TexCoord;\n"
-		"}\n"
-	,
-		//fragment shader:
-		"#version 330\n"
-		"uniform sampler2D TEX;\n"
-		"in vec4 color;\n"
-		"in vec2 texCoord;\n"
-		"out vec4 fragColor;\n"
-		"void main() {\n"
-		"	fragColor = texture(TEX, texCoord) * color;\n"
-		"}\n"
-	);
-	//As you can see above, adjacent strings in C/C++ are concatenated.
-	// this is very useful for writing long shader programs inline.
+ColorTextureProgram::ColorTextureProgram(uint32_t features_) : features(features_) {
+	//Compile (or find already compiled) variant:
+	ProgramPermutations::Variant const &variant = permutations().get(features);
+	program = variant.program;
 
 	//look up the locations of vertex attributes:
-	Position_vec4 = glGetAttribLocation(program, "Position");
-	Color_vec4 = glGetAttribLocation(program, "Color");
-	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
+	Position_vec4 = variant.attribute("Position");
+	Color_vec4 = variant.attribute("Color");
+	TexCoord_vec2 = variant.attribute("TexCoord");
+	Center_vec2 = variant.attribute("Center");
+	Radius_vec2 = variant.attribute("Radius");
 
 	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
+	OBJECT_TO_COURT_mat4 = variant.uniform("OBJECT_TO_COURT");
+	GLuint TEX_sampler2D = variant.uniform("TEX");
 
 	//set TEX to always refer to texture binding zero:
-	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
+	if (TEX_sampler2D != -1U) {
+		gl_state.use_program(program); //bind program -- glUniform* calls refer to this program now
 
-	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
+		glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
-	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
-}
+		gl_state.use_program(0); //unbind program -- glUniform* calls refer to ??? now
+	}
 
-ColorTextureProgram::~ColorTextureProgram() {
-	glDeleteProgram(program);
-	program = 0;
+	GL_ERRORS();
 }
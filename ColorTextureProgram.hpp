@@ -1,22 +1,38 @@
 #pragma once
 
 #include "GL.hpp"
+#include "ProgramPermutations.hpp"
 
-//Shader program that draws transformed, textured vertices tinted with vertex colors:
+//Shader program that draws transformed vertices tinted with vertex colors -- optionally textured,
+// instanced, or shaped -- depending on which variant is asked for:
 struct ColorTextureProgram {
-	ColorTextureProgram();
-	~ColorTextureProgram();
+	//Features (OR together to pick a variant):
+	enum : uint32_t {
+		Textured = (1 << 0), //multiply by TEX sampled at TexCoord
+		Instanced = (1 << 1), //Position is a unit-quad corner, placed by per-instance Center/Radius
+		SDF = (1 << 2), //draw the ellipse inscribed in each rectangle (TexCoord in [-1,1]), antialiased
+	};
 
-	GLuint program = 0;
+	explicit ColorTextureProgram(uint32_t features = Textured);
+
+	uint32_t features = 0;
+	GLuint program = 0; //(owned by permutations(); don't delete)
 
 	//Attribute (per-vertex variable) locations:
+	// (-1U when not used by this variant)
 	GLuint Position_vec4 = -1U;
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
+	GLuint Center_vec2 = -1U; //Instanced only
+	GLuint Radius_vec2 = -1U; //Instanced only
 
 	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
+	GLuint OBJECT_TO_COURT_mat4 = -1U; //(identity until set)
+	//(COURT_TO_CLIP comes from the per-frame uniform buffer -- see frame_uniforms.hpp)
 
 	//Textures:
-	//TEXTURE0 - texture that is accessed by TexCoord
+	//TEXTURE0 - texture that is accessed by TexCoord (Textured only)
+
+	//Every variant of the program, compiled on demand and kept for the life of the GL context:
+	static ProgramPermutations &permutations();
 };
@@ -0,0 +1,106 @@
+#include "DamageTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//smallest box covering both:
+static DamageTracker::Box join(DamageTracker::Box const &a, DamageTracker::Box const &b) {
+	DamageTracker::Box ret;
+	ret.min = glm::min(a.min, b.min);
+	ret.max = glm::max(a.max, b.max);
+	return ret;
+}
+
+//do the boxes overlap or share an edge?
+static bool touching(DamageTracker::Box const &a, DamageTracker::Box const &b) {
+	return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+DamageTracker::Box DamageTracker::box_of(Rectangle const &r) const {
+	glm::vec2 half = 0.5f * glm::vec2(size);
+	glm::vec4 a = court_to_clip * glm::vec4(r.center - r.radius, 0.0f, 1.0f);
+	glm::vec4 b = court_to_clip * glm::vec4(r.center + r.radius, 0.0f, 1.0f);
+	glm::vec2 lo = (glm::min(glm::vec2(a), glm::vec2(b)) + 1.0f) * half;
+	glm::vec2 hi = (glm::max(glm::vec2(a), glm::vec2(b)) + 1.0f) * half;
+	Box box;
+	box.min = glm::max(glm::ivec2(std::floor(lo.x), std::floor(lo.y)) - 1, glm::ivec2(0));
+	box.max = glm::min(glm::ivec2(std::ceil(hi.x), std::ceil(hi.y)) + 1, glm::ivec2(size));
+	return box;
+}
+
+void DamageTracker::update(glm::uvec2 const &size_, glm::mat4 const &court_to_clip_, std::vector< Rectangle > const &moving, bool invalidate) {
+	bool all = invalidate || first || size_ != size || court_to_clip_ != court_to_clip;
+	first = false;
+	size = size_;
+	court_to_clip = court_to_clip_;
+
+	dirty.clear();
+	if (!all) {
+		//old and new spots of everything that changed:
+		size_t slots = std::max(previous.size(), moving.size());
+		for (size_t i = 0; i < slots && !all; ++i) {
+			bool had = (i < previous.size());
+			bool has = (i < moving.size());
+			if (had && has && previous[i] == moving[i]) continue;
+			if (had) dirty.emplace_back(box_of(previous[i]));
+			if (has) dirty.emplace_back(box_of(moving[i]));
+			if (dirty.size() > 2 * MaxChanges) all = true;
+		}
+		dirty.erase(std::remove_if(dirty.begin(), dirty.end(), [](Box const &b){ return b.empty(); }), dirty.end());
+	}
+
+	if (!all) {
+		//merge boxes that overlap (so no pixel is redrawn twice):
+		for (bool merged = true; merged; ) {
+			merged = false;
+			for (size_t i = 0; i < dirty.size(); ++i) {
+				for (size_t j = i + 1; j < dirty.size(); ++j) {
+					if (!touching(dirty[i], dirty[j])) continue;
+					dirty[i] = join(dirty[i], dirty[j]);
+					dirty.erase(dirty.begin() + j);
+					merged = true;
+					--j;
+				}
+			}
+		}
+
+		//then merge whichever pair grows least until there are few enough:
+		while (dirty.size() > MaxBoxes) {
+			size_t best_i = 0, best_j = 1;
+			int64_t best_growth = INT64_MAX;
+			for (size_t i = 0; i < dirty.size(); ++i) {
+				for (size_t j = i + 1; j < dirty.size(); ++j) {
+					int64_t growth = join(dirty[i], dirty[j]).area() - dirty[i].area() - dirty[j].area();
+					if (growth < best_growth) {
+						best_growth = growth;
+						best_i = i;
+						best_j = j;
+					}
+				}
+			}
+			dirty[best_i] = join(dirty[best_i], dirty[best_j]);
+			dirty.erase(dirty.begin() + best_j);
+		}
+
+		//if most of the frame is dirty anyway, redraw all of it:
+		int64_t area = 0;
+		for (auto const &b : dirty) area += b.area();
+		if (2 * area > int64_t(size.x) * int64_t(size.y)) all = true;
+	}
+
+	if (all) {
+		dirty.clear();
+		Box frame;
+		frame.max = glm::ivec2(size);
+		if (!frame.empty()) dirty.emplace_back(frame);
+	}
+	everything = all;
+
+	bounds = Box();
+	if (!dirty.empty()) {
+		bounds = dirty[0];
+		for (auto const &b : dirty) bounds = join(bounds, b);
+	}
+
+	previous = moving;
+}
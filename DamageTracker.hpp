@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Rectangle.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * DamageTracker works out which parts of a frame need redrawing, given the rectangles that can move.
+ *
+ * Each call to update() compares this frame's moving rectangles with last frame's (slot by slot --
+ * the i'th rectangle is assumed to be the same object as last frame's i'th), and marks both the old
+ * and new pixel bounds of anything that changed as dirty. Everything else in the frame (background,
+ * static rectangles, things that didn't move) is assumed to be exactly as it was last frame, so
+ * callers draw into a target that keeps its contents and only redraw inside 'dirty'.
+ *
+ * The whole frame is dirty on the first update, when the size or court-to-clip transform changes,
+ * when the caller passes 'invalidate' (e.g., it switched targets or the art changed), or when
+ * so much changed that redrawing piecemeal wouldn't save anything.
+ */
+
+struct DamageTracker {
+	//pixels [min,max), with y going up (like glScissor):
+	struct Box {
+		glm::ivec2 min = glm::ivec2(0);
+		glm::ivec2 max = glm::ivec2(0);
+		bool empty() const { return min.x >= max.x || min.y >= max.y; }
+		int64_t area() const { return empty() ? 0 : int64_t(max.x - min.x) * int64_t(max.y - min.y); }
+	};
+
+	//compute 'dirty' for a 'size' frame where 'moving' are drawn through 'court_to_clip':
+	void update(glm::uvec2 const &size, glm::mat4 const &court_to_clip, std::vector< Rectangle > const &moving, bool invalidate);
+
+	//what needs redrawing this frame (no more than MaxBoxes, possibly none):
+	std::vector< Box > dirty;
+	Box bounds; //bounding box of 'dirty' (for things that can only take one box, like glScissor)
+	bool everything = true; //is 'dirty' the whole frame?
+
+	//boxes merge (smallest growth first) down to this many:
+	static constexpr uint32_t MaxBoxes = 8;
+	//more changed rectangles than this and the whole frame is just redrawn:
+	static constexpr uint32_t MaxChanges = 64;
+
+	//----- internals -----
+	glm::uvec2 size = glm::uvec2(0);
+	glm::mat4 court_to_clip = glm::mat4(1.0f);
+	std::vector< Rectangle > previous; //last frame's 'moving'
+	bool first = true;
+
+	//pixels a rectangle might touch (with a pixel of slack for rasterization rounding), clipped to the frame:
+	Box box_of(Rectangle const &rectangle) const;
+};
@@ -1,81 +1,85 @@
 #include "FoosballMode.hpp"
 
+//for gl_state (which skips redundant binds/enables):
+#include "GLStateCache.hpp"
+
+//for Packfile::assets (where the sprite atlas is):
+#include "Packfile.hpp"
+
+//for the per-frame uniform buffer (COURT_TO_CLIP, TIME, RESOLUTION):
+#include "frame_uniforms.hpp"
+
 //for the GL_ERRORS() macro:
 #include "gl_errors.hpp"
 
 //for glm::value_ptr() :
 #include <glm/gtc/type_ptr.hpp>
 
+#include <iostream>
 #include <random>
 
 FoosballMode::FoosballMode() {
 
 	
 	//----- allocate OpenGL resources -----
-	{ //vertex buffer:
-		glGenBuffers(1, &vertex_buffer);
-		//for now, buffer will be un-filled.
-
-		GL_ERRORS(); //PARANOIA: print out any OpenGL errors that may have happened
-	}
+	//(vertex_buffer allocates its own storage; vertices are streamed into it each frame)
 
 	{ //vertex array mapping buffer for color_texture_program:
 		//ask OpenGL to fill vertex_buffer_for_color_texture_program with the name of an unused vertex array object:
 		glGenVertexArrays(1, &vertex_buffer_for_color_texture_program);
 
 		//set vertex_buffer_for_color_texture_program as the current vertex array object:
-		glBindVertexArray(vertex_buffer_for_color_texture_program);
+		gl_state.bind_vertex_array(vertex_buffer_for_color_texture_program);
 
 		//set vertex_buffer as the source of glVertexAttribPointer() commands:
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-		//set up the vertex array object to describe arrays of FoosballMode::Vertex:
-		glVertexAttribPointer(
-			color_texture_program.Position_vec4, //attribute
-			3, //size
-			GL_FLOAT, //type
-			GL_FALSE, //normalized
-			sizeof(Vertex), //stride
-			(GLbyte *)0 + 0 //offset
-		);
-		glEnableVertexAttribArray(color_texture_program.Position_vec4);
-		//[Note that it is okay to bind a vec3 input to a vec4 attribute -- the w component will be filled with 1.0 automatically]
-
-		glVertexAttribPointer(
-			color_texture_program.Color_vec4, //attribute
-			4, //size
-			GL_UNSIGNED_BYTE, //type
-			GL_TRUE, //normalized
-			sizeof(Vertex), //stride
-			(GLbyte *)0 + 4*3 //offset
-		);
-		glEnableVertexAttribArray(color_texture_program.Color_vec4);
-
-		glVertexAttribPointer(
-			color_texture_program.TexCoord_vec2, //attribute
-			2, //size
-			GL_FLOAT, //type
-			GL_FALSE, //normalized
-			sizeof(Vertex), //stride
-			(GLbyte *)0 + 4*3 + 4*1 //offset
-		);
-		glEnableVertexAttribArray(color_texture_program.TexCoord_vec2);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer.buffer);
+
+		//set up the vertex array object to describe arrays of RectangleVertex:
+		rectangle_vertex_attribs(color_texture_program);
+
+		//...drawn with the shared rectangle index buffer:
+		bind_rectangle_indices(0);
 
 		//done referring to vertex_buffer, so unbind it:
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
 
 		//done setting up vertex array object, so unbind it:
-		glBindVertexArray(0);
+		gl_state.bind_vertex_array(0);
 
 		GL_ERRORS(); //PARANOIA: print out any OpenGL errors that may have happened
 	}
 
+	{ //walls and nets never move, so they are built (and uploaded) once:
+		auto draw_rectangle = [this](glm::vec2 const &center, glm::vec2 const &radius, glm::u8vec4 const &color) {
+			static_rectangles.emplace_back(center, radius, color);
+		};
+		const glm::u8vec4 white_color = glm::u8vec4(0xff, 0xff, 0xff, 0xff);
+
+		//walls:
+		draw_rectangle(glm::vec2(0.0f, 0.0f), glm::vec2(wall_radius, court_radius.y + 2.0f * wall_radius), white_color);
+		draw_rectangle(glm::vec2(-court_radius.x-wall_radius, 0.0f), glm::vec2(wall_radius, court_radius.y + 2.0f * wall_radius), white_color);
+		draw_rectangle(glm::vec2( court_radius.x+wall_radius, 0.0f), glm::vec2(wall_radius, court_radius.y + 2.0f * wall_radius), white_color);
+		draw_rectangle(glm::vec2( 0.0f,-court_radius.y-wall_radius), glm::vec2(court_radius.x, wall_radius), white_color);
+		draw_rectangle(glm::vec2( 0.0f, court_radius.y+wall_radius), glm::vec2(court_radius.x, wall_radius), white_color);
+
+		//nets:
+		draw_rectangle(glm::vec2(-court_radius.x-wall_radius-2.0f, 0.0f), glm::vec2(2.0f+wall_radius, net_radius), white_color);
+		draw_rectangle(glm::vec2(court_radius.x+wall_radius+2.0f, 0.0f), glm::vec2(2.0f+wall_radius, net_radius), white_color);
+
+		retained_rectangles.set_static(static_rectangles);
+	}
+
+	//sprite atlas (only there if the build packed one -- see the PackAtlas rule in the Jamfile):
+	if (Packfile::assets && Packfile::assets->contains("sprites.atlas")) {
+		sprite_atlas.reset(new SpriteAtlas(*Packfile::assets, "sprites"));
+	}
+
 	{ //solid white texture:
 		//ask OpenGL to fill white_tex with the name of an unused texture object:
 		glGenTextures(1, &white_tex);
 
 		//bind that texture object as a GL_TEXTURE_2D-type texture:
-		glBindTexture(GL_TEXTURE_2D, white_tex);
+		gl_state.bind_texture(GL_TEXTURE_2D, white_tex);
 
 		//upload a 1x1 image of solid white to the texture:
 		glm::uvec2 size = glm::uvec2(1,1);
@@ -93,7 +97,7 @@ FoosballMode::FoosballMode() {
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		//Okay, texture uploaded, can unbind it:
-		glBindTexture(GL_TEXTURE_2D, 0);
+		gl_state.bind_texture(GL_TEXTURE_2D, 0);
 
 		GL_ERRORS(); //PARANOIA: print out any OpenGL errors that may have happened
 	}
@@ -102,13 +106,10 @@ FoosballMode::FoosballMode() {
 FoosballMode::~FoosballMode() {
 
 	//----- free OpenGL resources -----
-	glDeleteBuffers(1, &vertex_buffer);
-	vertex_buffer = 0;
-
-	glDeleteVertexArrays(1, &vertex_buffer_for_color_texture_program);
+	gl_state.delete_vertex_array(vertex_buffer_for_color_texture_program);
 	vertex_buffer_for_color_texture_program = 0;
 
-	glDeleteTextures(1, &white_tex);
+	gl_state.delete_texture(white_tex);
 	white_tex = 0;
 }
 
@@ -170,12 +171,36 @@ bool FoosballMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_s
         if (evt.key.keysym.sym == SDLK_RETURN) {
             return_pressed = true;
         }
+		if (evt.key.keysym.sym == SDLK_F1) {
+			//cycle through ways of getting rectangles on screen (for comparing performance):
+			if (render_path == RenderPath::Retained) render_path = RenderPath::Streamed;
+			else if (render_path == RenderPath::Streamed) render_path = RenderPath::Instanced;
+			else if (render_path == RenderPath::Instanced && sprite_atlas) render_path = RenderPath::Sprites;
+			else if (render_path == RenderPath::Instanced || render_path == RenderPath::Sprites) render_path = RenderPath::Software;
+			else render_path = RenderPath::Retained;
+			std::cout << "Render path: " << (render_path == RenderPath::Retained ? "retained" : render_path == RenderPath::Streamed ? "streamed"
+				: render_path == RenderPath::Instanced ? "instanced" : render_path == RenderPath::Sprites ? "sprites" : "software") << std::endl;
+		}
+		if (evt.key.keysym.sym == SDLK_F4) {
+			//toggle redrawing only what changed (see DamageTracker.hpp):
+			damage_tracking = !damage_tracking;
+			damage_valid = false;
+			std::cout << "Damage tracking: " << (damage_tracking ? "on" : "off") << std::endl;
+		}
+		if (evt.key.keysym.sym == SDLK_F2) {
+			//cycle stress test through 0, 1000, 10000, 100000 extra rectangles:
+			stress_rectangles = (stress_rectangles == 0 ? 1000 : stress_rectangles >= 100000 ? 0 : stress_rectangles * 10);
+			std::cout << "Stress rectangles: " << stress_rectangles << std::endl;
+		}
 
     }
+	//keys change what's shown (colors, render path...), even while frozen:
+	if (evt.type == SDL_KEYDOWN || evt.type == SDL_KEYUP) changed();
 	return false;
 }
 
 void FoosballMode::update(float elapsed) {
+	time += elapsed;
 
 	static std::mt19937 mt; //mersenne twister pseudo-random number generator
 
@@ -549,6 +574,11 @@ void FoosballMode::update(float elapsed) {
 
 }
 
+float FoosballMode::idle_for() const {
+	//everything is frozen while celebrating a goal:
+	return celebration;
+}
+
 void FoosballMode::draw(glm::uvec2 const &drawable_size) {
 	//some nice colors from the course web page:
 	#define HEX_TO_U8VEC4( HX ) (glm::u8vec4( (HX >> 24) & 0xff, (HX >> 16) & 0xff, (HX >> 8) & 0xff, (HX) & 0xff ))
@@ -561,37 +591,20 @@ void FoosballMode::draw(glm::uvec2 const &drawable_size) {
 	#undef HEX_TO_U8VEC4
 
 	//other useful drawing constants:
-	const float wall_radius = 0.05f;
 //	const float shadow_offset = 0.07f;
 	const float padding = 0.14f; //padding between outside of walls and edge of window
 
-	//---- compute vertices to draw ----
-
-	//vertices will be accumulated into this list and then uploaded+drawn at the end of this function:
-	std::vector< Vertex > vertices;
+	//---- compute rectangles to draw ----
 
+	//rectangles that move (or appear) during play are accumulated into this list:
+	// (the walls and nets are in static_rectangles)
+	std::vector< Rectangle > rectangles;
 
 	//inline helper function for rectangle drawing:
-	auto draw_rectangle = [&vertices](glm::vec2 const &center, glm::vec2 const &radius, glm::u8vec4 const &color) {
-		//draw rectangle as two CCW-oriented triangles:
-		vertices.emplace_back(glm::vec3(center.x-radius.x, center.y-radius.y, 0.0f), color, glm::vec2(0.5f, 0.5f));
-		vertices.emplace_back(glm::vec3(center.x+radius.x, center.y-radius.y, 0.0f), color, glm::vec2(0.5f, 0.5f));
-		vertices.emplace_back(glm::vec3(center.x+radius.x, center.y+radius.y, 0.0f), color, glm::vec2(0.5f, 0.5f));
-		vertices.emplace_back(glm::vec3(center.x-radius.x, center.y-radius.y, 0.0f), color, glm::vec2(0.5f, 0.5f));
-		vertices.emplace_back(glm::vec3(center.x+radius.x, center.y+radius.y, 0.0f), color, glm::vec2(0.5f, 0.5f));
-		vertices.emplace_back(glm::vec3(center.x-radius.x, center.y+radius.y, 0.0f), color, glm::vec2(0.5f, 0.5f));
+	auto draw_rectangle = [&rectangles](glm::vec2 const &center, glm::vec2 const &radius, glm::u8vec4 const &color) {
+		rectangles.emplace_back(center, radius, color);
 	};
 
-	//walls:
-    draw_rectangle(glm::vec2(0.0f, 0.0f), glm::vec2(wall_radius, court_radius.y + 2.0f * wall_radius), white_color);
-	draw_rectangle(glm::vec2(-court_radius.x-wall_radius, 0.0f), glm::vec2(wall_radius, court_radius.y + 2.0f * wall_radius), white_color);
-	draw_rectangle(glm::vec2( court_radius.x+wall_radius, 0.0f), glm::vec2(wall_radius, court_radius.y + 2.0f * wall_radius), white_color);
-	draw_rectangle(glm::vec2( 0.0f,-court_radius.y-wall_radius), glm::vec2(court_radius.x, wall_radius), white_color);
-	draw_rectangle(glm::vec2( 0.0f, court_radius.y+wall_radius), glm::vec2(court_radius.x, wall_radius), white_color);
-
-    draw_rectangle(glm::vec2(-court_radius.x-wall_radius-2.0f, 0.0f), glm::vec2(2.0f+wall_radius, net_radius), white_color);
-    draw_rectangle(glm::vec2(court_radius.x+wall_radius+2.0f, 0.0f), glm::vec2(2.0f+wall_radius, net_radius), white_color);
-
 	//paddles:
 	if (q_pressed) {
         for (auto def: left_defenders) {
@@ -634,6 +647,7 @@ void FoosballMode::draw(glm::uvec2 const &drawable_size) {
         }
     }
 	//ball:
+	size_t ball_rectangle = rectangles.size(); //(the sprite path draws this one with the ball sprite)
 	draw_rectangle(ball, ball_radius, white_color);
 
 	//scores:
@@ -645,6 +659,16 @@ void FoosballMode::draw(glm::uvec2 const &drawable_size) {
 		draw_rectangle(glm::vec2( court_radius.x - (2.0f + 3.0f * i) * score_radius.x, court_radius.y + 2.0f * wall_radius + 2.0f * score_radius.y), score_radius, opposing_color);
 	}
 
+	//stress test: lots of small rectangles scattered over the court (F2 changes how many):
+	if (stress_rectangles > 0) {
+		static std::mt19937 mt(0x15e7);
+		std::uniform_real_distribution< float > x(-court_radius.x, court_radius.x);
+		std::uniform_real_distribution< float > y(-court_radius.y, court_radius.y);
+		for (uint32_t i = 0; i < stress_rectangles; ++i) {
+			draw_rectangle(glm::vec2(x(mt), y(mt)), ball_radius, glm::u8vec4(mt() & 0xff, mt() & 0xff, mt() & 0xff, 0x80));
+		}
+	}
+
 	//------ compute court-to-window transform ------
 
 	//compute area that should be visible:
@@ -688,46 +712,150 @@ void FoosballMode::draw(glm::uvec2 const &drawable_size) {
 
 	//---- actual drawing ----
 
-	//clear the color buffer:
-	glClearColor(bg_color.r / 255.0f, bg_color.g / 255.0f, bg_color.b / 255.0f, bg_color.a / 255.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
-
-	//use alpha blending:
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	//don't use the depth test:
-	glDisable(GL_DEPTH_TEST);
-
-	//upload vertices to vertex_buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]), vertices.data(), GL_STREAM_DRAW); //upload vertices array
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	{ //per-frame values every program reads (one upload, however many programs draw):
+		FrameUniforms frame;
+		frame.COURT_TO_CLIP = court_to_clip;
+		frame.TIME = time;
+		frame.RESOLUTION = glm::vec2(drawable_size);
+		upload_frame_uniforms(frame);
+	}
 
-	//set color_texture_program as current program:
-	glUseProgram(color_texture_program.program);
+	//---- damage tracking ----
+	//(with F4, only what changed since last frame is redrawn; the rest stays in an offscreen target)
+	GLint window_framebuffer = 0; //(wherever main() wants this frame to end up)
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &window_framebuffer);
+	if (damage_tracking) {
+		OffscreenTarget const &kept = (render_path == RenderPath::Software ? software_target : damage_target);
+		GLuint atlas_texture = (render_path == RenderPath::Sprites ? sprite_atlas->texture(white_tex) : 0);
+		bool invalidate = !damage_valid || kept.size != drawable_size
+			|| render_path != damage_render_path || atlas_texture != damage_atlas_texture;
+		damage_valid = true;
+		damage_render_path = render_path;
+		damage_atlas_texture = atlas_texture;
+		damage.update(drawable_size, court_to_clip, rectangles, invalidate);
+	}
 
-	//upload OBJECT_TO_CLIP to the proper uniform location:
-	glUniformMatrix4fv(color_texture_program.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(court_to_clip));
+	if (render_path == RenderPath::Software) {
+		//rasterized on the CPU (by tiles, in parallel)...
+		software_renderer.add(static_rectangles);
+		software_renderer.add(rectangles);
+		software_renderer.draw(drawable_size, bg_color, court_to_clip, damage_tracking ? &damage.dirty : nullptr);
+
+		//...then uploaded (just the changed part, if tracking damage)...
+		software_target.resize(drawable_size);
+		DamageTracker::Box upload;
+		upload.max = glm::ivec2(drawable_size);
+		if (damage_tracking) upload = damage.bounds;
+		if (!upload.empty()) {
+			gl_state.bind_texture(GL_TEXTURE_2D, software_target.color_tex);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, drawable_size.x);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, upload.min.x, upload.min.y, upload.max.x - upload.min.x, upload.max.y - upload.min.y,
+				GL_RGBA, GL_UNSIGNED_BYTE, software_renderer.pixels.data() + size_t(upload.min.y) * drawable_size.x + upload.min.x);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
 
-	//use the mapping vertex_buffer_for_color_texture_program to fetch vertex data:
-	glBindVertexArray(vertex_buffer_for_color_texture_program);
+		//...and copied over whatever framebuffer is being drawn to:
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, software_target.framebuffer);
+		glBlitFramebuffer(0, 0, drawable_size.x, drawable_size.y, 0, 0, drawable_size.x, drawable_size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, window_framebuffer);
 
-	//bind the solid white texture to location zero so things will be drawn just with their colors:
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, white_tex);
+		GL_ERRORS(); //PARANOIA: print errors just in case we did something wrong.
+		return;
+	}
 
-	//run the OpenGL pipeline:
-	glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()));
+	if (damage_tracking) {
+		//draw into the kept frame, only inside the changed part:
+		// (one scissor box, so this is the bounding box of everything dirty)
+		damage_target.resize(drawable_size);
+		damage_target.bind();
+		gl_state.enable(GL_SCISSOR_TEST);
+		glScissor(damage.bounds.min.x, damage.bounds.min.y, damage.bounds.max.x - damage.bounds.min.x, damage.bounds.max.y - damage.bounds.min.y);
+	}
 
-	//unbind the solid white texture:
-	glBindTexture(GL_TEXTURE_2D, 0);
+	if (!damage_tracking || !damage.bounds.empty()) {
+		//clear the color buffer:
+		glClearColor(bg_color.r / 255.0f, bg_color.g / 255.0f, bg_color.b / 255.0f, bg_color.a / 255.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		//use alpha blending:
+		gl_state.enable(GL_BLEND);
+		gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		//don't use the depth test:
+		gl_state.disable(GL_DEPTH_TEST);
+
+		if (render_path == RenderPath::Instanced) {
+			//every rectangle is one instance of a unit quad:
+			// (InstancedRectangles uses its own program variant)
+			instanced_rectangles.add(static_rectangles);
+			instanced_rectangles.add(rectangles);
+			instanced_rectangles.draw();
+		} else if (render_path == RenderPath::Sprites) {
+			//everything is cut from one atlas texture, so this is one draw call however the art varies:
+			SpriteAtlas::Region const &white = sprite_atlas->lookup("white");
+			SpriteAtlas::Region const &ball_sprite = sprite_atlas->contains("ball") ? sprite_atlas->lookup("ball") : white;
+			GLuint atlas_texture = sprite_atlas->texture(white_tex);
+			auto submit = [this,atlas_texture](int32_t layer, Rectangle const &r, SpriteAtlas::Region const &region) {
+				sprite_batch.submit(atlas_texture, SpriteBatch::Blend::Alpha, layer,
+					SpriteBatch::Sprite{ r.center, r.radius, region.uv_min, region.uv_max, r.color });
+			};
+			for (auto const &r : static_rectangles) submit(0, r, white);
+			for (size_t i = 0; i < rectangles.size(); ++i) {
+				submit(1, rectangles[i], i == ball_rectangle ? ball_sprite : white);
+			}
+			sprite_batch.draw();
+		} else {
+			//set color_texture_program as current program:
+			gl_state.use_program(color_texture_program.program);
+
+			//upload OBJECT_TO_COURT to the proper uniform location:
+			// (vertex positions are relative to vertex_extent, so they need scaling back to court coordinates;
+			//  COURT_TO_CLIP itself comes from the per-frame uniform buffer)
+			glUniformMatrix4fv(color_texture_program.OBJECT_TO_COURT_mat4, 1, GL_FALSE, glm::value_ptr(rectangle_vertex_to_object(vertex_extent)));
+
+			//(the untextured program variant doesn't sample anything, so no texture needs binding)
+
+			if (render_path == RenderPath::Retained) {
+				//only rectangles that changed since last frame get uploaded:
+				retained_rectangles.set_dynamic(rectangles);
+				retained_rectangles.draw();
+			} else { //RenderPath::Streamed
+				//every vertex is rebuilt and streamed each frame:
+				std::vector< RectangleVertex > vertices;
+				vertices.reserve((static_rectangles.size() + rectangles.size()) * RectangleVertices);
+				for (auto const &r : static_rectangles) append_rectangle(r, vertex_extent, &vertices);
+				for (auto const &r : rectangles) append_rectangle(r, vertex_extent, &vertices);
+
+				//stream vertices into this frame's part of vertex_buffer:
+				// (aligned to whole vertices, so the offset can be passed to glDrawElementsBaseVertex as a base vertex)
+				vertex_buffer.begin_frame();
+				GLintptr vertices_offset = vertex_buffer.write(vertices.data(), vertices.size() * sizeof(vertices[0]), sizeof(vertices[0]));
+
+				//use the mapping vertex_buffer_for_color_texture_program to fetch vertex data:
+				gl_state.bind_vertex_array(vertex_buffer_for_color_texture_program);
+
+				//run the OpenGL pipeline:
+				size_t count = vertices.size() / RectangleVertices;
+				bind_rectangle_indices(count);
+				glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(count * RectangleIndices), GL_UNSIGNED_INT, (GLbyte *)0, GLint(vertices_offset / sizeof(vertices[0])));
+
+				//done reading this frame's vertices:
+				vertex_buffer.end_frame();
+			}
 
-	//reset vertex array to none:
-	glBindVertexArray(0);
+			//(program and vertex array stay bound: gl_state skips re-binding them next frame,
+			// and anything else that draws will bind what it needs through gl_state as well)
+		}
+	}
 
-	//reset current program to none:
-	glUseProgram(0);
-	
+	if (damage_tracking) {
+		//copy the whole kept frame to the window (a copy, not a redraw -- the window's old contents can't be trusted):
+		gl_state.disable(GL_SCISSOR_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, window_framebuffer);
+		glViewport(0, 0, drawable_size.x, drawable_size.y);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, damage_target.framebuffer);
+		glBlitFramebuffer(0, 0, drawable_size.x, drawable_size.y, 0, 0, drawable_size.x, drawable_size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, window_framebuffer);
+	}
 
 	GL_ERRORS(); //PARANOIA: print errors just in case we did something wrong.
 
@@ -1,10 +1,20 @@
 #include "ColorTextureProgram.hpp"
+#include "StreamingBuffer.hpp"
+#include "RetainedRectangles.hpp"
+#include "InstancedRectangles.hpp"
+#include "SpriteAtlas.hpp"
+#include "SpriteBatch.hpp"
+#include "SoftwareRenderer.hpp"
+#include "OffscreenTarget.hpp"
+#include "DamageTracker.hpp"
+#include "rectangles.hpp"
 
 #include "Mode.hpp"
 #include "GL.hpp"
 
 #include <glm/glm.hpp>
 
+#include <memory>
 #include <vector>
 #include <deque>
 
@@ -20,10 +30,12 @@ struct FoosballMode : Mode {
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
 	virtual void update(float elapsed) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
+	virtual float idle_for() const override;
 
 	//----- game state -----
 
 	glm::vec2 court_radius = glm::vec2(15.0f, 12.0f);
+	float wall_radius = 0.05f;
 	glm::vec2 paddle_radius = glm::vec2(0.3f, 0.5f);
 	glm::vec2 ball_radius = glm::vec2(0.2f, 0.2f);
 
@@ -68,33 +80,72 @@ struct FoosballMode : Mode {
 //	float trail_length = 1.3f;
 //	std::deque< glm::vec3 > ball_trail; //stores (x,y,age), oldest elements first
 
+	//seconds since the mode started (passed to shaders as TIME):
+	float time = 0.0f;
+
 	//----- opengl assets / helpers ------
 
-	//draw functions will work on vectors of vertices, defined as follows:
-	struct Vertex {
-		Vertex(glm::vec3 const &Position_, glm::u8vec4 const &Color_, glm::vec2 const &TexCoord_) :
-			Position(Position_), Color(Color_), TexCoord(TexCoord_) { }
-		glm::vec3 Position;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 4*3 + 1*4 + 4*2, "FoosballMode::Vertex should be packed");
+	//draw() builds a list of Rectangles (see rectangles.hpp) and then gets them to the GPU by one of these paths:
+	enum class RenderPath {
+		Retained, //rectangles kept in a GL buffer, only changed ones re-uploaded (retained_rectangles)
+		Streamed, //every rectangle's vertices rebuilt and streamed each frame (vertex_buffer)
+		Instanced, //one instance per rectangle, streamed each frame (instanced_rectangles)
+		Sprites, //sprites cut from the build-time atlas, batched by layer/blend/texture (sprite_batch)
+		Software, //rasterized on the CPU, then uploaded (software_renderer)
+	} render_path = RenderPath::Retained; //(F1 cycles)
+
+	//extra rectangles drawn each frame to stress the render paths (F2 cycles):
+	uint32_t stress_rectangles = 0;
+
+	//Vertex positions are stored relative to this (as normalized shorts -- see rectangles.hpp),
+	// so it needs to cover everything drawn (walls, nets, and score pips):
+	glm::vec2 vertex_extent = glm::vec2(20.0f, 14.0f);
 
 	//Shader program that draws transformed, vertices tinted with vertex colors:
-	ColorTextureProgram color_texture_program;
+	// (every rectangle is a flat color, so this is the untextured variant -- TexCoord goes unused)
+	ColorTextureProgram color_texture_program = ColorTextureProgram(0);
 
-	//Buffer used to hold vertex data during drawing:
-	GLuint vertex_buffer = 0;
+	//Ring buffer that each frame's vertex data is streamed into:
+	StreamingBuffer vertex_buffer;
 
 	//Vertex Array Object that maps buffer locations to color_texture_program attribute locations:
 	GLuint vertex_buffer_for_color_texture_program = 0;
 
+	//Walls and nets (built once, in the constructor):
+	std::vector< Rectangle > static_rectangles;
+
+	//Static rectangles plus the moving ones, kept on the GPU between frames:
+	RetainedRectangles retained_rectangles{ color_texture_program, vertex_extent };
+
+	//Everything as instances of one quad:
+	InstancedRectangles instanced_rectangles;
+
+	//Sprites packed at build time from the 'sprites' directory (null if the packfile has no atlas):
+	// (until its texture has streamed in, sprites are drawn with white_tex)
+	std::unique_ptr< SpriteAtlas > sprite_atlas;
+
+	//Everything as atlas sprites -- the walls on one layer, things that move above them:
+	SpriteBatch sprite_batch;
+
+	//CPU rasterizer, and the texture its frames are uploaded to for display:
+	SoftwareRenderer software_renderer;
+	OffscreenTarget software_target;
+
+	//Damage tracking (F4 toggles): only the parts of the frame where something moved are redrawn,
+	// into a target that keeps the rest between frames (the software path keeps its frame in software_target):
+	bool damage_tracking = false;
+	DamageTracker damage;
+	OffscreenTarget damage_target;
+	bool damage_valid = false; //false when the kept frame can't be trusted (so everything gets redrawn)
+	RenderPath damage_render_path = RenderPath::Retained; //path that drew the kept frame
+	GLuint damage_atlas_texture = 0; //atlas texture the sprite path drew it with (changes once the atlas streams in)
+
 	//Solid white texture:
 	GLuint white_tex = 0;
 
 	//matrix that maps from clip coordinates to court-space coordinates:
 	glm::mat3x2 clip_to_court = glm::mat3x2(1.0f);
-	// computed in draw() as the inverse of OBJECT_TO_CLIP
+	// computed in draw() as the inverse of COURT_TO_CLIP
 	// (stored here so that the mouse handling code can use it to position the paddle)
 
 };
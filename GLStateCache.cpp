@@ -0,0 +1,108 @@
+#include "GLStateCache.hpp"
+
+GLStateCache gl_state;
+
+void GLStateCache::enable(GLenum cap) {
+	auto f = caps.find(cap);
+	if (!issue(f == caps.end() || !f->second)) return;
+	glEnable(cap);
+	caps[cap] = true;
+}
+
+void GLStateCache::disable(GLenum cap) {
+	auto f = caps.find(cap);
+	if (!issue(f == caps.end() || f->second)) return;
+	glDisable(cap);
+	caps[cap] = false;
+}
+
+void GLStateCache::blend_func(GLenum sfactor, GLenum dfactor) {
+	if (!issue(!blend_known || blend_src != sfactor || blend_dst != dfactor)) return;
+	glBlendFunc(sfactor, dfactor);
+	blend_known = true;
+	blend_src = sfactor;
+	blend_dst = dfactor;
+}
+
+void GLStateCache::use_program(GLuint program_) {
+	if (!issue(!program_known || program != program_)) return;
+	glUseProgram(program_);
+	program_known = true;
+	program = program_;
+}
+
+void GLStateCache::bind_vertex_array(GLuint vertex_array_) {
+	if (!issue(!vertex_array_known || vertex_array != vertex_array_)) return;
+	glBindVertexArray(vertex_array_);
+	vertex_array_known = true;
+	vertex_array = vertex_array_;
+}
+
+void GLStateCache::bind_buffer(GLenum target, GLuint buffer) {
+	if (target == GL_ELEMENT_ARRAY_BUFFER) {
+		//(part of the vertex array object's state, so not tracked)
+		issue(true);
+		glBindBuffer(target, buffer);
+		return;
+	}
+	auto f = buffers.find(target);
+	if (!issue(f == buffers.end() || f->second != buffer)) return;
+	glBindBuffer(target, buffer);
+	buffers[target] = buffer;
+}
+
+void GLStateCache::active_texture(GLenum unit_) {
+	if (!issue(!unit_known || unit != unit_)) return;
+	glActiveTexture(unit_);
+	unit_known = true;
+	unit = unit_;
+}
+
+void GLStateCache::bind_texture(GLenum target, GLuint texture) {
+	//(if the active unit isn't known, neither is anything bound to it)
+	uint64_t key = (uint64_t(unit) << 32) | target;
+	auto f = textures.find(key);
+	if (!issue(!unit_known || f == textures.end() || f->second != texture)) return;
+	glBindTexture(target, texture);
+	if (unit_known) textures[key] = texture;
+}
+
+//deleting a bound object binds zero in its place:
+void GLStateCache::delete_program(GLuint program_) {
+	if (program_known && program == program_) program_known = false; //(stays in use until replaced)
+	glDeleteProgram(program_);
+}
+
+void GLStateCache::delete_vertex_array(GLuint vertex_array_) {
+	if (vertex_array_known && vertex_array == vertex_array_) vertex_array = 0;
+	glDeleteVertexArrays(1, &vertex_array_);
+}
+
+void GLStateCache::delete_buffer(GLuint buffer) {
+	for (auto &b : buffers) {
+		if (b.second == buffer) b.second = 0;
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void GLStateCache::delete_texture(GLuint texture) {
+	for (auto &t : textures) {
+		if (t.second == texture) t.second = 0;
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void GLStateCache::invalidate() {
+	caps.clear();
+	blend_known = false;
+	program_known = false;
+	vertex_array_known = false;
+	buffers.clear();
+	unit_known = false;
+	textures.clear();
+}
+
+void GLStateCache::end_frame() {
+	last_frame = frame;
+	frame = Counts();
+}
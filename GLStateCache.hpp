@@ -0,0 +1,73 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * GLStateCache remembers the state it has set and skips calls that wouldn't change anything.
+ *
+ * Only state that goes through the cache is tracked, so code that draws should always use it for:
+ *  - glEnable / glDisable
+ *  - glBlendFunc
+ *  - glUseProgram
+ *  - glBindVertexArray
+ *  - glBindBuffer (except GL_ELEMENT_ARRAY_BUFFER, which belongs to the bound vertex array)
+ *  - glActiveTexture / glBindTexture
+ * ...and delete objects through it, so that names GL recycles aren't mistaken for still-bound ones.
+ * (If something else changes this state, call invalidate() afterward.)
+ */
+
+struct GLStateCache {
+	void enable(GLenum cap);
+	void disable(GLenum cap);
+	void blend_func(GLenum sfactor, GLenum dfactor);
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vertex_array);
+	void bind_buffer(GLenum target, GLuint buffer);
+	void active_texture(GLenum unit);
+	void bind_texture(GLenum target, GLuint texture); //(on the active unit)
+
+	void delete_program(GLuint program);
+	void delete_vertex_array(GLuint vertex_array);
+	void delete_buffer(GLuint buffer);
+	void delete_texture(GLuint texture);
+
+	//forget everything (the next call of each kind will be issued):
+	void invalidate();
+
+	//Calls actually made vs. skipped:
+	struct Counts {
+		uint32_t issued = 0;
+		uint32_t filtered = 0;
+	};
+	Counts frame; //so far this frame
+	Counts last_frame; //during the previous frame
+	void end_frame(); //called by main() after each frame
+
+	//----- internals -----
+	//(a missing entry means "unknown")
+	std::unordered_map< GLenum, bool > caps;
+	bool blend_known = false;
+	GLenum blend_src = 0, blend_dst = 0;
+	bool program_known = false;
+	GLuint program = 0;
+	bool vertex_array_known = false;
+	GLuint vertex_array = 0;
+	std::unordered_map< GLenum, GLuint > buffers; //target -> buffer
+	bool unit_known = false;
+	GLenum unit = GL_TEXTURE0;
+	std::unordered_map< uint64_t, GLuint > textures; //(unit << 32 | target) -> texture
+
+	//count a call as issued (returns true) or filtered (returns false):
+	bool issue(bool needed) {
+		if (needed) frame.issued += 1;
+		else frame.filtered += 1;
+		return needed;
+	}
+};
+
+//The state cache for the (one) GL context:
+extern GLStateCache gl_state;
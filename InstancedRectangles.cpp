@@ -0,0 +1,76 @@
+#include "InstancedRectangles.hpp"
+
+#include "GLStateCache.hpp"
+#include "gl_errors.hpp"
+
+#include <cstddef>
+
+InstancedRectangles::InstancedRectangles() {
+	{ //unit quad:
+		glm::vec2 corners[4] = {
+			glm::vec2(-1.0f,-1.0f), glm::vec2( 1.0f,-1.0f),
+			glm::vec2(-1.0f, 1.0f), glm::vec2( 1.0f, 1.0f),
+		};
+		glGenBuffers(1, &quad_buffer);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, quad_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	{ //vertex array: corners from quad_buffer, everything else per-instance:
+		glGenVertexArrays(1, &vertex_array);
+		gl_state.bind_vertex_array(vertex_array);
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, quad_buffer);
+		glVertexAttribPointer(program.Position_vec4, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (GLbyte *)0);
+		glEnableVertexAttribArray(program.Position_vec4);
+
+		//(per-instance pointers are set in draw(), since each frame's instances are at a different offset)
+		for (GLuint attrib : { program.Center_vec2, program.Radius_vec2, program.Color_vec4 }) {
+			glEnableVertexAttribArray(attrib);
+			glVertexAttribDivisor(attrib, 1);
+		}
+
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+		gl_state.bind_vertex_array(0);
+	}
+
+	GL_ERRORS();
+}
+
+InstancedRectangles::~InstancedRectangles() {
+	gl_state.delete_vertex_array(vertex_array);
+	vertex_array = 0;
+	gl_state.delete_buffer(quad_buffer);
+	quad_buffer = 0;
+}
+
+void InstancedRectangles::add(std::vector< Rectangle > const &rectangles) {
+	instances.reserve(instances.size() + rectangles.size());
+	for (auto const &r : rectangles) {
+		instances.emplace_back(Instance{ r.center, r.radius, r.color });
+	}
+}
+
+void InstancedRectangles::draw() {
+	if (instances.empty()) return;
+
+	instance_buffer.begin_frame();
+	GLintptr offset = instance_buffer.write(instances.data(), instances.size() * sizeof(Instance), sizeof(Instance));
+
+	gl_state.bind_vertex_array(vertex_array);
+
+	//point per-instance attributes at this frame's instances:
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, instance_buffer.buffer);
+	glVertexAttribPointer(program.Center_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLbyte *)0 + offset + offsetof(Instance, Center));
+	glVertexAttribPointer(program.Radius_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLbyte *)0 + offset + offsetof(Instance, Radius));
+	glVertexAttribPointer(program.Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (GLbyte *)0 + offset + offsetof(Instance, Color));
+
+	gl_state.use_program(program.program);
+
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(instances.size()));
+	//(program and vertex array stay bound -- gl_state will skip re-binding them next frame)
+
+	instance_buffer.end_frame();
+	instances.clear();
+}
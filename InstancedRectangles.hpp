@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ColorTextureProgram.hpp"
+#include "StreamingBuffer.hpp"
+#include "rectangles.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/*
+ * InstancedRectangles draws any number of rectangles with one instanced draw call.
+ *
+ * A static unit quad supplies the corners; each rectangle is one 20-byte instance
+ * (center, radius, packed color) streamed per frame.
+ */
+
+struct InstancedRectangles {
+	InstancedRectangles();
+	~InstancedRectangles();
+	InstancedRectangles(InstancedRectangles const &) = delete;
+	InstancedRectangles &operator=(InstancedRectangles const &) = delete;
+
+	//Per-instance data:
+	struct Instance {
+		glm::vec2 Center;
+		glm::vec2 Radius;
+		glm::u8vec4 Color;
+	};
+	static_assert(sizeof(Instance) == 4*2 + 4*2 + 1*4, "InstancedRectangles::Instance should be packed");
+
+	//queue rectangles to draw (in order) on the next call to draw():
+	void add(std::vector< Rectangle > const &rectangles);
+
+	//draw (and then clear) everything queued, in court coordinates:
+	// (binds its own program; COURT_TO_CLIP comes from the per-frame uniforms -- see frame_uniforms.hpp)
+	void draw();
+
+	std::vector< Instance > instances; //queued
+
+	//Instanced variant of the color/texture program:
+	ColorTextureProgram program = ColorTextureProgram(ColorTextureProgram::Instanced);
+
+	GLuint quad_buffer = 0; //four corners of [-1,1]x[-1,1], as a triangle strip
+	StreamingBuffer instance_buffer;
+	GLuint vertex_array = 0;
+};
@@ -0,0 +1,98 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(std::string const &filename) {
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(handle, &file_size)) {
+		CloseHandle(handle);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	file = handle;
+	length = size_t(file_size.QuadPart);
+	if (length == 0) return; //can't map an empty file, but it's not an error either
+	mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		throw std::runtime_error("Failed to create mapping of '" + filename + "'.");
+	}
+	bytes = reinterpret_cast< uint8_t const * >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (bytes == nullptr) {
+		close();
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	length = size_t(info.st_size);
+	if (length == 0) { //can't map an empty file, but it's not an error either
+		::close(fd);
+		return;
+	}
+	void *ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); //mapping holds its own reference to the file
+	if (ptr == MAP_FAILED) {
+		length = 0;
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+	bytes = reinterpret_cast< uint8_t const * >(ptr);
+#endif
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) {
+	*this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+	if (this == &other) return *this;
+	close();
+	std::swap(bytes, other.bytes);
+	std::swap(length, other.length);
+	#ifdef _WIN32
+	std::swap(file, other.file);
+	std::swap(mapping, other.mapping);
+	#endif
+	return *this;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (bytes) munmap(const_cast< uint8_t * >(bytes), length);
+#endif
+	bytes = nullptr;
+	length = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * MappedFile maps a whole file into memory (read-only) for as long as it lives.
+ */
+
+struct MappedFile {
+	MappedFile() = default;
+	explicit MappedFile(std::string const &filename); //NOTE: throws on error
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(MappedFile &&other);
+
+	uint8_t const *data() const { return bytes; }
+	size_t size() const { return length; }
+
+	//unmaps (if mapped); leaves the MappedFile empty:
+	void close();
+
+	uint8_t const *bytes = nullptr;
+	size_t length = 0;
+	#ifdef _WIN32
+	void *file = nullptr; //HANDLE
+	void *mapping = nullptr; //HANDLE
+	#endif
+};
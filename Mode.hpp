@@ -20,8 +20,23 @@ struct Mode : std::enable_shared_from_this< Mode > {
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//idle_for is how long (in seconds) the mode will look exactly the same if no events arrive, e.g.,
+	// while paused; main() stops redrawing and sleeps through idle time (update is still called).
+	// 0 means "changing now" (the default, which redraws every frame).
+	virtual float idle_for() const { return 0.0f; }
+
+	//While idle, main() calls draw once into a cached frame, then just copies that to the screen
+	// (one blit) with draw_overlay on top, until the mode stops being idle or calls changed():
+	virtual void draw_overlay(glm::uvec2 const &drawable_size) { }
+
+	//call when something that idle frames show has changed (e.g., in handle_event), to redraw the cached frame:
+	void changed() { ++change_count; }
+	uint32_t change_count = 0;
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
+	//NOTE: request textures through TextureStreamer::shared rather than loading them in a constructor,
+	// so that making and switching to a new Mode doesn't hold up a frame.
 	static std::shared_ptr< Mode > current;
 	static void set_current(std::shared_ptr< Mode > const &);
 };
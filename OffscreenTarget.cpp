@@ -0,0 +1,62 @@
+#include "OffscreenTarget.hpp"
+
+#include "GLStateCache.hpp"
+#include "gl_errors.hpp"
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+OffscreenTarget::~OffscreenTarget() {
+	if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = 0;
+	gl_state.delete_texture(color_tex);
+	color_tex = 0;
+}
+
+void OffscreenTarget::resize(glm::uvec2 const &new_size) {
+	if (new_size == size && framebuffer) return;
+	size = new_size;
+
+	if (color_tex == 0) glGenTextures(1, &color_tex);
+	gl_state.bind_texture(GL_TEXTURE_2D, color_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	GLint draw_framebuffer = 0, read_framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_framebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+	if (framebuffer == 0) {
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_tex, 0);
+	} else {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Offscreen framebuffer of size " + std::to_string(size.x) + "x" + std::to_string(size.y)
+			+ " is incomplete (status " + std::to_string(status) + ").");
+	}
+
+	GL_ERRORS();
+}
+
+void OffscreenTarget::bind() const {
+	assert(framebuffer && "call resize() before bind()");
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, size.x, size.y);
+}
+
+void OffscreenTarget::read_pixels(std::vector< glm::u8vec4 > *pixels) const {
+	assert(pixels);
+	pixels->resize(size_t(size.x) * size.y);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+}
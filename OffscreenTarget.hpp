@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+
+/*
+ * OffscreenTarget is a framebuffer object with a color texture attached, for drawing somewhere
+ * other than the window (headless runs, cached frames, rendering at a lower resolution, ...).
+ *
+ * Usage:
+ *   target.resize(size); //(re)allocates only if the size changed
+ *   target.bind();       //draws now go to color_tex
+ *   ...draw...
+ *   glBindFramebuffer(GL_FRAMEBUFFER, 0); //back to the window
+ */
+
+struct OffscreenTarget {
+	OffscreenTarget() = default;
+	~OffscreenTarget();
+	OffscreenTarget(OffscreenTarget const &) = delete;
+	OffscreenTarget &operator=(OffscreenTarget const &) = delete;
+
+	//make the color texture 'new_size' (RGBA8); contents are undefined after a size change:
+	// (framebuffer bindings are left as they were)
+	//NOTE: throws if the driver won't make the framebuffer complete
+	void resize(glm::uvec2 const &new_size);
+
+	//bind as the draw and read framebuffer and set the viewport to cover it:
+	void bind() const;
+
+	//copy the color texture back to the CPU (rows bottom-to-top, i.e., LowerLeftOrigin):
+	// (binds the framebuffer for reading)
+	void read_pixels(std::vector< glm::u8vec4 > *pixels) const;
+
+	glm::uvec2 size = glm::uvec2(0);
+	GLuint framebuffer = 0;
+	GLuint color_tex = 0; //(linear filtering, clamped at the edges -- so it can be drawn scaled)
+};
@@ -0,0 +1,70 @@
+#include "Packfile.hpp"
+
+#include <zlib.h>
+
+#include <cstring>
+#include <stdexcept>
+
+std::shared_ptr< Packfile > Packfile::assets;
+
+Packfile::Packfile(std::string const &filename_) : filename(filename_), file(filename_) {
+	auto bad = [this](std::string const &why) {
+		return std::runtime_error("Packfile '" + filename + "' " + why + ".");
+	};
+
+	PackHeader header;
+	if (file.size() < sizeof(header)) throw bad("is too small to be a packfile");
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, "NESTPACK", 8) != 0) throw bad("is not a packfile");
+	if (header.version != PackVersion) throw bad("has version " + std::to_string(header.version) + " (expecting " + std::to_string(PackVersion) + ")");
+	if (file.size() < sizeof(header) + size_t(header.count) * sizeof(PackEntry)) throw bad("has a truncated table of contents");
+
+	entries.reserve(header.count);
+	for (uint32_t i = 0; i < header.count; ++i) {
+		PackEntry entry;
+		std::memcpy(&entry, file.data() + sizeof(header) + i * sizeof(PackEntry), sizeof(entry));
+		if (size_t(entry.name_offset) + entry.name_length > file.size()
+		 || entry.offset > file.size() || entry.stored_size > file.size() - entry.offset) {
+			throw bad("has an entry that runs past the end of the file");
+		}
+		if (!(entry.flags & PackEntryCompressed) && entry.size != entry.stored_size) {
+			//(get() hands out uncompressed entries directly, so 'size' must be what's actually stored)
+			throw bad("has an uncompressed entry whose size doesn't match its stored size");
+		}
+		std::string name(reinterpret_cast< char const * >(file.data() + entry.name_offset), entry.name_length);
+		if (!entries.emplace(name, entry).second) throw bad("has two entries named '" + name + "'");
+	}
+}
+
+bool Packfile::contains(std::string const &name) const {
+	return entries.count(name) != 0;
+}
+
+Packfile::Span Packfile::get(std::string const &name) const {
+	auto f = entries.find(name);
+	if (f == entries.end()) {
+		throw std::runtime_error("Packfile '" + filename + "' has no entry named '" + name + "'.");
+	}
+	PackEntry const &entry = f->second;
+
+	Span ret;
+	if (!(entry.flags & PackEntryCompressed)) {
+		ret.data = file.data() + entry.offset;
+		ret.size = size_t(entry.size);
+		return ret;
+	}
+
+	std::unique_lock< std::mutex > lock(inflated_mutex);
+	auto i = inflated.find(name);
+	if (i == inflated.end()) {
+		std::vector< uint8_t > data(size_t(entry.size));
+		uLongf length = uLongf(data.size());
+		if (uncompress(data.data(), &length, file.data() + entry.offset, uLong(entry.stored_size)) != Z_OK || length != data.size()) {
+			throw std::runtime_error("Packfile '" + filename + "' entry '" + name + "' failed to decompress.");
+		}
+		i = inflated.emplace(name, std::move(data)).first;
+	}
+	ret.data = i->second.data();
+	ret.size = i->second.size();
+	return ret;
+}
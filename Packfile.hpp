@@ -0,0 +1,73 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Packfile serves named assets (shaders, images, ...) out of a single memory-mapped file,
+ * as built by the 'pack_assets' tool (see the PackAssets rule in the Jamfile).
+ *
+ * File layout (little-endian):
+ *   PackHeader
+ *   PackEntry[count]         -- table of contents
+ *   names                    -- entry names, back-to-back, not null-terminated
+ *   entry data               -- each entry starts on a PackAlignment boundary
+ */
+
+struct PackHeader {
+	char magic[8]; //"NESTPACK"
+	uint32_t version;
+	uint32_t count; //number of entries
+};
+static_assert(sizeof(PackHeader) == 16, "PackHeader is packed");
+
+struct PackEntry {
+	uint64_t offset; //of data, from start of file
+	uint64_t stored_size; //bytes in file
+	uint64_t size; //bytes once decompressed (== stored_size if not compressed)
+	uint32_t name_offset; //from start of file
+	uint32_t name_length;
+	uint32_t flags; //PackEntryCompressed
+	uint32_t reserved;
+};
+static_assert(sizeof(PackEntry) == 40, "PackEntry is packed");
+
+enum : uint32_t {
+	PackVersion = 1,
+	PackAlignment = 16,
+	PackEntryCompressed = 1, //data is a zlib stream
+};
+
+struct Packfile {
+	explicit Packfile(std::string const &filename); //NOTE: throws on error
+
+	//A run of bytes owned by the Packfile:
+	struct Span {
+		uint8_t const *data = nullptr;
+		size_t size = 0;
+		std::string as_string() const { return std::string(reinterpret_cast< char const * >(data), size); }
+	};
+
+	bool contains(std::string const &name) const;
+
+	//bytes of entry 'name' (throws if there is no such entry).
+	// uncompressed entries point straight into the mapped file; compressed entries are
+	// inflated on first request and kept for the life of the Packfile.
+	Span get(std::string const &name) const;
+
+	std::string filename;
+	MappedFile file;
+	std::unordered_map< std::string, PackEntry > entries;
+
+	mutable std::mutex inflated_mutex;
+	mutable std::unordered_map< std::string, std::vector< uint8_t > > inflated;
+
+	//packfile the game's assets are loaded from (set up in main()):
+	static std::shared_ptr< Packfile > assets;
+};
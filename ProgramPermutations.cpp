@@ -0,0 +1,110 @@
+#include "ProgramPermutations.hpp"
+
+#include "GLStateCache.hpp"
+#include "gl_compile_program.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+ProgramPermutations::ProgramPermutations(
+	std::string const &vertex_source_,
+	std::string const &fragment_source_,
+	std::vector< std::string > const &features_)
+	: vertex_source(vertex_source_), fragment_source(fragment_source_), features(features_) {
+	if (features.size() > 32) {
+		throw std::runtime_error("ProgramPermutations supports at most 32 features.");
+	}
+}
+
+ProgramPermutations::~ProgramPermutations() {
+	for (auto &v : variants) {
+		gl_state.delete_program(v.second.program);
+	}
+	variants.clear();
+}
+
+GLuint ProgramPermutations::Variant::attribute(std::string const &name) const {
+	auto f = attributes.find(name);
+	return (f == attributes.end() ? -1U : f->second);
+}
+
+GLuint ProgramPermutations::Variant::uniform(std::string const &name) const {
+	auto f = uniforms.find(name);
+	return (f == uniforms.end() ? -1U : f->second);
+}
+
+std::string ProgramPermutations::permute(std::string const &source, uint32_t mask) const {
+	std::string defines;
+	for (uint32_t i = 0; i < features.size(); ++i) {
+		if (mask & (1U << i)) defines += "#define " + features[i] + " 1\n";
+	}
+	if (mask >> features.size()) {
+		throw std::runtime_error("ProgramPermutations: feature mask " + std::to_string(mask) + " has bits with no feature.");
+	}
+
+	//'#version' must stay the first line, so defines go right after it:
+	size_t at = 0;
+	if (source.compare(0, 8, "#version") == 0) {
+		at = source.find('\n');
+		at = (at == std::string::npos ? source.size() : at + 1);
+	}
+	std::string ret = source.substr(0, at);
+	if (!ret.empty() && ret.back() != '\n') ret += '\n';
+	ret += defines;
+	ret += source.substr(at);
+	return ret;
+}
+
+void ProgramPermutations::prepare(std::vector< uint32_t > const &masks) {
+	std::vector< uint32_t > todo;
+	std::vector< GLProgramSources > sources;
+	for (uint32_t mask : masks) {
+		if (variants.count(mask) || std::find(todo.begin(), todo.end(), mask) != todo.end()) continue;
+		todo.emplace_back(mask);
+		sources.emplace_back(GLProgramSources{ permute(vertex_source, mask), permute(fragment_source, mask) });
+	}
+	if (todo.empty()) return;
+
+	std::vector< GLuint > programs = gl_compile_programs(sources);
+
+	for (uint32_t i = 0; i < todo.size(); ++i) {
+		Variant &variant = variants[todo[i]];
+		variant.features = todo[i];
+		variant.program = programs[i];
+
+		//record locations of everything the variant uses, so callers don't have to query:
+		GLint count = 0, max_length = 0;
+		std::vector< GLchar > name;
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+
+		glGetProgramiv(variant.program, GL_ACTIVE_ATTRIBUTES, &count);
+		glGetProgramiv(variant.program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+		name.assign(std::max(1, max_length), '\0');
+		for (GLint a = 0; a < count; ++a) {
+			glGetActiveAttrib(variant.program, GLuint(a), GLsizei(name.size()), &length, &size, &type, name.data());
+			std::string str(name.data(), length);
+			variant.attributes[str] = GLuint(glGetAttribLocation(variant.program, str.c_str()));
+		}
+
+		glGetProgramiv(variant.program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(variant.program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+		name.assign(std::max(1, max_length), '\0');
+		for (GLint u = 0; u < count; ++u) {
+			glGetActiveUniform(variant.program, GLuint(u), GLsizei(name.size()), &length, &size, &type, name.data());
+			std::string str(name.data(), length);
+			if (str.size() > 3 && str.compare(str.size() - 3, 3, "[0]") == 0) str.erase(str.size() - 3);
+			variant.uniforms[str] = GLuint(glGetUniformLocation(variant.program, str.c_str()));
+		}
+	}
+}
+
+ProgramPermutations::Variant const &ProgramPermutations::get(uint32_t mask) {
+	auto f = variants.find(mask);
+	if (f == variants.end()) {
+		prepare({ mask });
+		f = variants.find(mask);
+	}
+	return f->second;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * ProgramPermutations builds variants of one shader program from feature defines.
+ *
+ * Each feature is a preprocessor symbol; the variant for a set of features (a bitmask, with
+ * bit i standing for features[i]) is compiled from the sources with a '#define' for each of
+ * its features inserted just after the '#version' line. Variants are compiled (via
+ * gl_compile_programs) the first time they are requested and kept until the ProgramPermutations
+ * is destroyed.
+ */
+
+struct ProgramPermutations {
+	ProgramPermutations(
+		std::string const &vertex_source,
+		std::string const &fragment_source,
+		std::vector< std::string > const &features);
+	~ProgramPermutations(); //deletes all variants' programs
+	ProgramPermutations(ProgramPermutations const &) = delete;
+	ProgramPermutations &operator=(ProgramPermutations const &) = delete;
+
+	//A compiled variant, along with the locations of everything it actually uses:
+	struct Variant {
+		uint32_t features = 0;
+		GLuint program = 0;
+		std::unordered_map< std::string, GLuint > attributes; //active attribute name -> location
+		std::unordered_map< std::string, GLuint > uniforms; //active uniform name -> location ("[0]" stripped from arrays)
+
+		//location of 'name', or -1U if this variant doesn't use it:
+		GLuint attribute(std::string const &name) const;
+		GLuint uniform(std::string const &name) const;
+	};
+
+	//variant with the given features, compiled on first request (throws on compile error):
+	Variant const &get(uint32_t features);
+
+	//compile several variants at once, so their compiles overlap:
+	// (already-compiled variants are skipped)
+	void prepare(std::vector< uint32_t > const &features);
+
+	//source text for a variant:
+	std::string permute(std::string const &source, uint32_t features) const;
+
+	std::string vertex_source;
+	std::string fragment_source;
+	std::vector< std::string > features;
+
+	std::unordered_map< uint32_t, Variant > variants;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+//An axis-aligned, flat-colored rectangle (everything FoosballMode draws is one of these):
+// (kept apart from rectangles.hpp, which has the GL-side helpers, so CPU-only code needn't pull in GL)
+struct Rectangle {
+	Rectangle(glm::vec2 const &center_, glm::vec2 const &radius_, glm::u8vec4 const &color_) :
+		center(center_), radius(radius_), color(color_) { }
+	glm::vec2 center;
+	glm::vec2 radius;
+	glm::u8vec4 color;
+
+	bool operator==(Rectangle const &o) const { return center == o.center && radius == o.radius && color == o.color; }
+	bool operator!=(Rectangle const &o) const { return !(*this == o); }
+};
@@ -0,0 +1,98 @@
+#include "ResolutionScaler.hpp"
+
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//readings in a row that must leave room for a bigger scale before stepping up:
+// (stepping down happens right away, since that's a frame over budget)
+static constexpr uint32_t ReadingsBeforeStepUp = 10;
+
+ResolutionScaler::ResolutionScaler(float budget_) : budget(budget_) {
+	glGenQueries(Queries, queries);
+	GL_ERRORS();
+}
+
+ResolutionScaler::~ResolutionScaler() {
+	glDeleteQueries(Queries, queries);
+}
+
+glm::uvec2 ResolutionScaler::begin(glm::uvec2 const &drawable_size) {
+	adjust();
+
+	glm::uvec2 size = glm::uvec2(
+		std::max(1U, uint32_t(std::round(drawable_size.x * scale))),
+		std::max(1U, uint32_t(std::round(drawable_size.y * scale)))
+	);
+	target.resize(size);
+	target.bind();
+
+	scales[next_query] = scale;
+	glBeginQuery(GL_TIME_ELAPSED, queries[next_query]);
+	cpu_begin = std::chrono::high_resolution_clock::now();
+
+	return size;
+}
+
+void ResolutionScaler::end(GLuint framebuffer, glm::uvec2 const &drawable_size) {
+	glEndQuery(GL_TIME_ELAPSED);
+	cpu_times[next_query] = std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - cpu_begin).count();
+	next_query = (next_query + 1) % Queries;
+	pending_queries += 1;
+
+	//stretch (filtered) over the output:
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glBlitFramebuffer(0, 0, target.size.x, target.size.y, 0, 0, drawable_size.x, drawable_size.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, drawable_size.x, drawable_size.y);
+
+	GL_ERRORS();
+}
+
+void ResolutionScaler::adjust() {
+	float step = 1.0f / ScaleSteps;
+	while (pending_queries > 0) {
+		uint32_t oldest = (next_query + Queries - pending_queries) % Queries;
+		//only wait for a result if every query is in use (i.e., the GPU is several frames behind):
+		if (pending_queries < Queries) {
+			GLint available = 0;
+			glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) break;
+		}
+		GLuint64 gpu_ns = 0;
+		glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &gpu_ns);
+		pending_queries -= 1;
+
+		frame_time = std::max(cpu_times[oldest], float(gpu_ns) * 1e-9f);
+
+		//fill cost goes with pixel count -- i.e., scale squared -- so this scale would just fit the budget:
+		recent_fits[next_fit] = scales[oldest] * std::sqrt(budget / std::max(frame_time, 1e-6f));
+		next_fit = (next_fit + 1) % Recent;
+		recent_count = std::min(Recent, recent_count + 1);
+
+		//go by the median of recent readings, so one hitch (a shader compile, an alt-tab) doesn't move the scale:
+		// (and wait for enough readings that the median means something)
+		if (recent_count < Recent / 2 + 1) continue;
+		float sorted[Recent];
+		std::copy(recent_fits, recent_fits + recent_count, sorted);
+		std::sort(sorted, sorted + recent_count);
+		float fit = sorted[recent_count / 2];
+		fit = std::floor(fit * ScaleSteps) / ScaleSteps;
+		fit = std::max(min_scale, std::min(max_scale, fit));
+
+		if (fit < scale) {
+			scale = fit;
+			step_up_readings = 0;
+		} else if (fit >= scale + step) {
+			step_up_readings += 1;
+			if (step_up_readings >= ReadingsBeforeStepUp) {
+				scale = std::min(max_scale, scale + step);
+				step_up_readings = 0;
+			}
+		} else {
+			step_up_readings = 0;
+		}
+	}
+}
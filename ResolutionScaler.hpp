@@ -0,0 +1,75 @@
+#pragma once
+
+#include "OffscreenTarget.hpp"
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <stdint.h>
+
+/*
+ * ResolutionScaler draws frames at a fraction of the drawable's resolution and stretches them to fit,
+ * picking the fraction from measured frame times so that drawing stays within 'budget' seconds.
+ *
+ * Usage (each frame):
+ *   glm::uvec2 size = scaler.begin(drawable_size); //binds an offscreen target that is 'size'
+ *   ...draw as if the drawable were 'size'...
+ *   scaler.end(framebuffer, drawable_size); //stretches it over 'framebuffer'
+ *
+ * Frame time is the larger of the CPU time between begin() and end() and the GPU time measured by a
+ * GL_TIME_ELAPSED query. Query results are read a few frames late (so waiting on them never stalls);
+ * since fill cost goes with pixel count, the scale moves toward sqrt(budget / time) of what it is --
+ * going by the median of the last few readings, so a single slow frame is ignored.
+ *
+ * The scale changes in steps of 1/ScaleSteps (and only by a full step), so the target -- and anything
+ * the mode keeps at drawable size -- is reallocated only when frame times really change.
+ *
+ * Anything that maps window coordinates to clip coordinates (like FoosballMode's clip_to_court) is
+ * unaffected: clip space still covers the whole window after stretching.
+ */
+
+struct ResolutionScaler {
+	ResolutionScaler(float budget = 6.9e-3f);
+	~ResolutionScaler();
+	ResolutionScaler(ResolutionScaler const &) = delete;
+	ResolutionScaler &operator=(ResolutionScaler const &) = delete;
+
+	//bind a target to draw this frame into, and return its size:
+	glm::uvec2 begin(glm::uvec2 const &drawable_size);
+
+	//stretch the frame over 'framebuffer' (which is 'drawable_size'), then bind that framebuffer:
+	void end(GLuint framebuffer, glm::uvec2 const &drawable_size);
+
+	float budget; //seconds per frame to aim for
+	float scale = 1.0f; //fraction of drawable_size (in each dimension) being drawn
+	float min_scale = 0.25f;
+	float max_scale = 1.0f;
+	static constexpr uint32_t ScaleSteps = 16;
+
+	//most recently measured frame time (seconds):
+	float frame_time = 0.0f;
+
+	//----- internals -----
+	OffscreenTarget target;
+
+	//GL_TIME_ELAPSED queries, used round-robin (each frame's CPU time waits alongside its query):
+	static constexpr uint32_t Queries = 4;
+	GLuint queries[Queries] = { };
+	float cpu_times[Queries] = { };
+	float scales[Queries] = { }; //scale each was drawn at
+	uint32_t next_query = 0; //used by the next begin()
+	uint32_t pending_queries = 0; //started and not yet read (the oldest is next_query - pending_queries)
+
+	std::chrono::high_resolution_clock::time_point cpu_begin;
+	uint32_t step_up_readings = 0; //readings in a row with room for the next step up
+
+	//scales that would have just fit the budget, from the most recent readings:
+	static constexpr uint32_t Recent = 5;
+	float recent_fits[Recent] = { };
+	uint32_t next_fit = 0;
+	uint32_t recent_count = 0;
+
+	//read back finished queries and move 'scale' toward the budget:
+	void adjust();
+};
@@ -0,0 +1,98 @@
+#include "RetainedRectangles.hpp"
+
+#include "GLStateCache.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+
+RetainedRectangles::RetainedRectangles(ColorTextureProgram const &program, glm::vec2 const &extent_) : extent(extent_) {
+	glGenBuffers(1, &buffer);
+	glGenVertexArrays(1, &vertex_array);
+
+	gl_state.bind_vertex_array(vertex_array);
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, buffer);
+	rectangle_vertex_attribs(program);
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+	gl_state.bind_vertex_array(0);
+
+	GL_ERRORS();
+}
+
+RetainedRectangles::~RetainedRectangles() {
+	gl_state.delete_vertex_array(vertex_array);
+	vertex_array = 0;
+	gl_state.delete_buffer(buffer);
+	buffer = 0;
+}
+
+void RetainedRectangles::set_static(std::vector< Rectangle > const &static_rectangles) {
+	std::vector< Rectangle > dynamic_rectangles(rectangles.begin() + static_count, rectangles.end());
+	rectangles = static_rectangles;
+	static_count = static_rectangles.size();
+	rectangles.insert(rectangles.end(), dynamic_rectangles.begin(), dynamic_rectangles.end());
+	dirty.assign(rectangles.size(), true); //everything moved
+}
+
+void RetainedRectangles::set_dynamic(std::vector< Rectangle > const &dynamic_rectangles) {
+	size_t count = static_count + dynamic_rectangles.size();
+	for (size_t i = 0; i < dynamic_rectangles.size(); ++i) {
+		size_t slot = static_count + i;
+		if (slot < rectangles.size()) {
+			if (rectangles[slot] != dynamic_rectangles[i]) {
+				rectangles[slot] = dynamic_rectangles[i];
+				dirty[slot] = true;
+			}
+		} else {
+			rectangles.emplace_back(dynamic_rectangles[i]);
+			dirty.emplace_back(true);
+		}
+	}
+	//(slots past the end just stop being drawn)
+	rectangles.resize(count, Rectangle(glm::vec2(0.0f), glm::vec2(0.0f), glm::u8vec4(0)));
+	dirty.resize(count);
+}
+
+void RetainedRectangles::draw() {
+	uploaded_ranges = 0;
+	uploaded_bytes = 0;
+	if (rectangles.empty()) return;
+
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, buffer);
+
+	//grow storage (re-uploading everything) if needed:
+	if (rectangles.size() > capacity) {
+		capacity = std::max< size_t >(64, capacity);
+		while (capacity < rectangles.size()) capacity *= 2;
+		glBufferData(GL_ARRAY_BUFFER, capacity * RectangleVertices * sizeof(RectangleVertex), nullptr, GL_DYNAMIC_DRAW);
+		std::fill(dirty.begin(), dirty.end(), true);
+	}
+
+	//upload each run of dirty rectangles:
+	std::vector< RectangleVertex > vertices;
+	for (size_t begin = 0; begin < rectangles.size(); ) {
+		if (!dirty[begin]) {
+			++begin;
+			continue;
+		}
+		size_t end = begin;
+		vertices.clear();
+		while (end < rectangles.size() && dirty[end]) {
+			append_rectangle(rectangles[end], extent, &vertices);
+			dirty[end] = false;
+			++end;
+		}
+		glBufferSubData(GL_ARRAY_BUFFER,
+			begin * RectangleVertices * sizeof(RectangleVertex),
+			vertices.size() * sizeof(RectangleVertex),
+			vertices.data()
+		);
+		uploaded_ranges += 1;
+		uploaded_bytes += vertices.size() * sizeof(RectangleVertex);
+		begin = end;
+	}
+
+	gl_state.bind_vertex_array(vertex_array);
+	bind_rectangle_indices(rectangles.size());
+	glDrawElements(GL_TRIANGLES, GLsizei(rectangles.size() * RectangleIndices), GL_UNSIGNED_INT, (GLbyte *)0);
+	//(vertex array stays bound -- gl_state will skip re-binding it next frame)
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "rectangles.hpp"
+
+#include <vector>
+
+/*
+ * RetainedRectangles keeps a list of rectangles in a GL buffer between frames.
+ *
+ * The list is a 'static' part (uploaded once, when set) followed by a 'dynamic' part that is
+ * set every frame. Only the slots whose rectangles actually changed are marked dirty, and only
+ * dirty ranges are re-uploaded (with glBufferSubData) when drawing.
+ */
+
+struct RetainedRectangles {
+	//vertex positions are stored relative to 'extent' (see rectangles.hpp):
+	RetainedRectangles(ColorTextureProgram const &program, glm::vec2 const &extent);
+	~RetainedRectangles();
+	RetainedRectangles(RetainedRectangles const &) = delete;
+	RetainedRectangles &operator=(RetainedRectangles const &) = delete;
+
+	//replace the static rectangles (which are drawn first):
+	void set_static(std::vector< Rectangle > const &rectangles);
+
+	//set the dynamic rectangles (drawn after the static ones, in order):
+	void set_dynamic(std::vector< Rectangle > const &rectangles);
+
+	//upload whatever changed, then draw everything:
+	// (expects 'program' to be in use, with OBJECT_TO_COURT set to rectangle_vertex_to_object(extent))
+	void draw();
+
+	glm::vec2 extent;
+
+	std::vector< Rectangle > rectangles; //static ones, then dynamic ones
+	size_t static_count = 0;
+	std::vector< bool > dirty; //per rectangle: needs upload?
+
+	GLuint buffer = 0;
+	GLuint vertex_array = 0; //maps buffer to program's attributes
+	size_t capacity = 0; //rectangles 'buffer' has room for
+
+	//what the last draw() uploaded:
+	uint32_t uploaded_ranges = 0;
+	size_t uploaded_bytes = 0;
+};
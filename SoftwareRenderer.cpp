@@ -0,0 +1,99 @@
+#include "SoftwareRenderer.hpp"
+
+#include "ThreadPool.hpp"
+#include "pixel_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void SoftwareRenderer::add(std::vector< Rectangle > const &rectangles) {
+	queued.insert(queued.end(), rectangles.begin(), rectangles.end());
+}
+
+void SoftwareRenderer::draw(glm::uvec2 const &size_, glm::u8vec4 const &clear_color, glm::mat4 const &court_to_clip,
+	std::vector< DamageTracker::Box > const *dirty) {
+	if (size_ != size) {
+		size = size_;
+		pixels.resize(size_t(size.x) * size.y);
+		dirty = nullptr; //(nothing left to keep)
+	}
+	tiles = (size + glm::uvec2(TileSize - 1)) / TileSize;
+	binned.resize(size_t(tiles.x) * tiles.y);
+	for (auto &bin : binned) bin.clear();
+
+	//----- which tiles get drawn -----
+	redraw.assign(binned.size(), dirty ? 0 : 1);
+	if (dirty) {
+		for (auto const &box : *dirty) {
+			glm::ivec2 min = glm::max(box.min, glm::ivec2(0));
+			glm::ivec2 max = glm::min(box.max, glm::ivec2(size));
+			if (min.x >= max.x || min.y >= max.y) continue;
+			glm::uvec2 t0 = glm::uvec2(min) / TileSize;
+			glm::uvec2 t1 = (glm::uvec2(max) - 1U) / TileSize;
+			for (uint32_t ty = t0.y; ty <= t1.y; ++ty) {
+				for (uint32_t tx = t0.x; tx <= t1.x; ++tx) {
+					redraw[ty * tiles.x + tx] = 1;
+				}
+			}
+		}
+	}
+	redraw_tiles.clear();
+	for (uint32_t t = 0; t < uint32_t(redraw.size()); ++t) {
+		if (redraw[t]) redraw_tiles.emplace_back(t);
+	}
+
+	//----- rectangles to pixel spans -----
+	// (a pixel is covered when its center is inside, so edges round to the nearest pixel boundary)
+	spans.clear();
+	spans.reserve(queued.size());
+	glm::vec2 half = 0.5f * glm::vec2(size);
+	for (auto const &r : queued) {
+		if (r.color.a == 0) continue;
+		glm::vec4 a = court_to_clip * glm::vec4(r.center - r.radius, 0.0f, 1.0f);
+		glm::vec4 b = court_to_clip * glm::vec4(r.center + r.radius, 0.0f, 1.0f);
+		glm::vec2 lo = (glm::min(glm::vec2(a), glm::vec2(b)) + 1.0f) * half;
+		glm::vec2 hi = (glm::max(glm::vec2(a), glm::vec2(b)) + 1.0f) * half;
+		Span span;
+		span.min = glm::ivec2(std::ceil(lo.x - 0.5f), std::ceil(lo.y - 0.5f));
+		span.max = glm::ivec2(std::ceil(hi.x - 0.5f), std::ceil(hi.y - 0.5f));
+		span.min = glm::max(span.min, glm::ivec2(0));
+		span.max = glm::min(span.max, glm::ivec2(size));
+		if (span.min.x >= span.max.x || span.min.y >= span.max.y) continue;
+		span.color = r.color;
+
+		//bin into every tile it touches (that is being drawn):
+		uint32_t index = uint32_t(spans.size());
+		spans.emplace_back(span);
+		glm::uvec2 t0 = glm::uvec2(span.min) / TileSize;
+		glm::uvec2 t1 = (glm::uvec2(span.max) - 1U) / TileSize;
+		for (uint32_t ty = t0.y; ty <= t1.y; ++ty) {
+			for (uint32_t tx = t0.x; tx <= t1.x; ++tx) {
+				if (redraw[ty * tiles.x + tx]) binned[ty * tiles.x + tx].emplace_back(index);
+			}
+		}
+	}
+	queued.clear();
+
+	//----- fill tiles in parallel -----
+	ThreadPool::shared().parallel_for(redraw_tiles.size(), [&](size_t i) {
+		uint32_t t = redraw_tiles[i];
+		glm::ivec2 tile_min = glm::ivec2(int32_t(t % tiles.x), int32_t(t / tiles.x)) * int32_t(TileSize);
+		glm::ivec2 tile_max = glm::min(tile_min + glm::ivec2(TileSize), glm::ivec2(size));
+
+		for (int32_t y = tile_min.y; y < tile_max.y; ++y) {
+			std::fill_n(pixels.data() + size_t(y) * size.x + tile_min.x, tile_max.x - tile_min.x, clear_color);
+		}
+
+		for (uint32_t index : binned[t]) {
+			Span const &span = spans[index];
+			glm::ivec2 min = glm::max(span.min, tile_min);
+			glm::ivec2 max = glm::min(span.max, tile_max);
+			size_t count = size_t(max.x - min.x);
+			for (int32_t y = min.y; y < max.y; ++y) {
+				glm::u8vec4 *row = pixels.data() + size_t(y) * size.x + min.x;
+				if (span.color.a == 0xff) std::fill_n(row, count, span.color);
+				else blend_over(row, count, span.color);
+			}
+		}
+	});
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Rectangle.hpp"
+#include "DamageTracker.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * SoftwareRenderer draws lists of Rectangles into a CPU-side framebuffer, making no GL calls
+ * (for servers, tests, and frame export -- or just to compare against the GPU paths).
+ *
+ * The framebuffer is split into TileSize x TileSize tiles. Rectangles are binned into the tiles they
+ * touch, then tiles are filled in parallel (ThreadPool::shared()) -- each by one thread, so no
+ * locking is needed. Within a tile, rectangles are drawn in order: opaque spans are plain stores
+ * and translucent spans are blended with the vectorized blend_over (see pixel_kernels.hpp).
+ *
+ * Results match GL's rasterization rules (a pixel is covered if its center is) and blending
+ * with glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+ *
+ * Given a list of dirty boxes (see DamageTracker.hpp), only tiles touching them are redrawn; the
+ * rest of the framebuffer keeps last frame's pixels.
+ */
+
+struct SoftwareRenderer {
+	static constexpr uint32_t TileSize = 64;
+
+	//queue rectangles to draw (in order) on the next call to draw():
+	void add(std::vector< Rectangle > const &rectangles);
+
+	//resize the framebuffer to 'size', clear it to 'clear_color', and draw (then clear) everything queued;
+	// 'court_to_clip' takes rectangle coordinates to [-1,1]x[-1,1] just like on the GPU:
+	// if 'dirty' is given, only tiles touching those boxes are cleared and drawn
+	// (it's ignored when the size changes, since the old pixels are gone)
+	void draw(glm::uvec2 const &size, glm::u8vec4 const &clear_color, glm::mat4 const &court_to_clip,
+		std::vector< DamageTracker::Box > const *dirty = nullptr);
+
+	//the framebuffer; rows go bottom to top (LowerLeftOrigin), like glReadPixels:
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< glm::u8vec4 > pixels;
+
+	//----- internals -----
+	std::vector< Rectangle > queued;
+
+	//a rectangle's pixels, [min,max) (already clipped to the framebuffer):
+	struct Span {
+		glm::ivec2 min, max;
+		glm::u8vec4 color;
+	};
+	std::vector< Span > spans;
+	glm::uvec2 tiles = glm::uvec2(0); //tile grid size
+	std::vector< std::vector< uint32_t > > binned; //per tile, indices into 'spans', in drawing order
+	std::vector< uint8_t > redraw; //per tile, is it being drawn this time?
+	std::vector< uint32_t > redraw_tiles; //indices of tiles being drawn
+};
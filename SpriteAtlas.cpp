@@ -0,0 +1,54 @@
+#include "SpriteAtlas.hpp"
+
+#include "load_save_png.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+SpriteAtlas::SpriteAtlas(Packfile const &pack, std::string const &name) {
+	//----- table -----
+	std::istringstream table(pack.get(name + ".atlas").as_string());
+	std::string tag;
+	if (!(table >> tag >> size.x >> size.y) || tag != "atlas" || size.x == 0 || size.y == 0) {
+		throw std::runtime_error("Sprite atlas table '" + name + ".atlas' does not start with 'atlas <width> <height>'.");
+	}
+	std::string image;
+	glm::uvec2 at, image_size;
+	while (table >> image >> at.x >> at.y >> image_size.x >> image_size.y) {
+		if (at.x + image_size.x > size.x || at.y + image_size.y > size.y) {
+			throw std::runtime_error("Sprite atlas table '" + name + ".atlas' places '" + image + "' outside the atlas.");
+		}
+		Region region;
+		region.uv_min = glm::vec2(at) / glm::vec2(size);
+		region.uv_max = glm::vec2(at + image_size) / glm::vec2(size);
+		region.size = image_size;
+		regions[image] = region;
+	}
+	if (!table.eof()) {
+		throw std::runtime_error("Sprite atlas table '" + name + ".atlas' has a malformed line.");
+	}
+
+	//----- image (decoded and uploaded in the background) -----
+	if (!pack.contains(name + ".png")) {
+		throw std::runtime_error("Sprite atlas image '" + name + ".png' is missing.");
+	}
+	//(the image must be the size the table was packed for, or every region's UVs are off)
+	Packfile::Span png = pack.get(name + ".png");
+	glm::uvec2 png_dims = png_size(png.data, png.size);
+	if (png_dims != size) {
+		throw std::runtime_error("Sprite atlas image '" + name + ".png' is " + std::to_string(png_dims.x) + "x" + std::to_string(png_dims.y)
+			+ ", but its table says " + std::to_string(size.x) + "x" + std::to_string(size.y) + ".");
+	}
+	if (!TextureStreamer::shared) {
+		throw std::runtime_error("SpriteAtlas needs TextureStreamer::shared to be set up first.");
+	}
+	image = TextureStreamer::shared->request(name + ".png");
+}
+
+SpriteAtlas::Region const &SpriteAtlas::lookup(std::string const &name) const {
+	auto f = regions.find(name);
+	if (f == regions.end()) {
+		throw std::runtime_error("Sprite atlas has no image named '" + name + "'.");
+	}
+	return f->second;
+}
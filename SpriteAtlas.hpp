@@ -0,0 +1,46 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Packfile.hpp"
+#include "TextureStreamer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <unordered_map>
+
+/*
+ * SpriteAtlas is one texture holding many images, as packed at build time by 'pack_atlas'
+ * (see the PackAtlas rule in the Jamfile), plus the table of where each image landed.
+ *
+ * Drawing everything out of one atlas means sprites with different art still share a texture,
+ * so SpriteBatch can merge them into a single draw call.
+ *
+ * The table is read right away; the image streams in through TextureStreamer::shared.
+ */
+
+struct SpriteAtlas {
+	//read the table '<name>.atlas' from 'pack' and request '<name>.png' from TextureStreamer::shared:
+	//NOTE: throws on error
+	SpriteAtlas(Packfile const &pack, std::string const &name);
+
+	//Where an image is in the atlas:
+	struct Region {
+		glm::vec2 uv_min = glm::vec2(0.0f); //texture coordinates of lower-left corner
+		glm::vec2 uv_max = glm::vec2(0.0f); //...and of upper-right corner
+		glm::uvec2 size = glm::uvec2(0); //in pixels
+	};
+
+	//region of image 'name' (path relative to the sprite directory, without '.png'); throws if missing:
+	// ('white' is always present -- a single white pixel, for flat-colored quads)
+	Region const &lookup(std::string const &name) const;
+	bool contains(std::string const &name) const { return regions.count(name) != 0; }
+
+	//the atlas texture, or 'fallback' while it is still streaming in:
+	// (linear filtering, no mipmaps -- they would bleed between images)
+	GLuint texture(GLuint fallback) const { return TextureStreamer::shared->texture(image, fallback); }
+
+	TextureStreamer::Handle image = 0;
+	glm::uvec2 size = glm::uvec2(0);
+	std::unordered_map< std::string, Region > regions;
+};
@@ -0,0 +1,109 @@
+#include "SpriteBatch.hpp"
+
+#include "GLStateCache.hpp"
+#include "gl_errors.hpp"
+#include "rectangles.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+SpriteBatch::SpriteBatch() {
+	//vertex array: everything comes from vertex_buffer, located per-draw by base vertex:
+	glGenVertexArrays(1, &vertex_array);
+	gl_state.bind_vertex_array(vertex_array);
+
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer.buffer);
+	glVertexAttribPointer(program.Position_vec4, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Position));
+	glEnableVertexAttribArray(program.Position_vec4);
+	glVertexAttribPointer(program.TexCoord_vec2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, TexCoord));
+	glEnableVertexAttribArray(program.TexCoord_vec2);
+	glVertexAttribPointer(program.Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + offsetof(Vertex, Color));
+	glEnableVertexAttribArray(program.Color_vec4);
+
+	//sprites are quads, so they share the rectangle index pattern:
+	bind_rectangle_indices(0);
+
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+	gl_state.bind_vertex_array(0);
+
+	GL_ERRORS();
+}
+
+SpriteBatch::~SpriteBatch() {
+	gl_state.delete_vertex_array(vertex_array);
+	vertex_array = 0;
+}
+
+void SpriteBatch::submit(GLuint texture, Blend blend, int32_t layer, Sprite const &sprite) {
+	submissions.emplace_back(Submission{ layer, blend, texture, sprite });
+}
+
+void SpriteBatch::draw() {
+	draw_calls = 0;
+	texture_binds = 0;
+	if (submissions.empty()) return;
+
+	//----- sort into runs -----
+	//(stable, so sprites with the same state keep their submission order)
+	std::stable_sort(submissions.begin(), submissions.end(), [](Submission const &a, Submission const &b) {
+		if (a.layer != b.layer) return a.layer < b.layer;
+		if (a.blend != b.blend) return a.blend < b.blend;
+		return a.texture < b.texture;
+	});
+
+	//----- build vertices (corners in the order bind_rectangle_indices expects) -----
+	vertices.clear();
+	vertices.reserve(submissions.size() * RectangleVertices);
+	for (auto const &s : submissions) {
+		Sprite const &sp = s.sprite;
+		vertices.emplace_back(Vertex{ sp.center + glm::vec2(-sp.radius.x,-sp.radius.y), glm::vec2(sp.uv_min.x, sp.uv_min.y), sp.color });
+		vertices.emplace_back(Vertex{ sp.center + glm::vec2( sp.radius.x,-sp.radius.y), glm::vec2(sp.uv_max.x, sp.uv_min.y), sp.color });
+		vertices.emplace_back(Vertex{ sp.center + glm::vec2( sp.radius.x, sp.radius.y), glm::vec2(sp.uv_max.x, sp.uv_max.y), sp.color });
+		vertices.emplace_back(Vertex{ sp.center + glm::vec2(-sp.radius.x, sp.radius.y), glm::vec2(sp.uv_min.x, sp.uv_max.y), sp.color });
+	}
+
+	//one upload for the whole frame:
+	vertex_buffer.begin_frame();
+	GLintptr offset = vertex_buffer.write(vertices.data(), vertices.size() * sizeof(Vertex), sizeof(Vertex));
+	GLint base_vertex = GLint(offset / sizeof(Vertex));
+
+	gl_state.use_program(program.program);
+
+	gl_state.bind_vertex_array(vertex_array);
+	bind_rectangle_indices(submissions.size());
+
+	gl_state.enable(GL_BLEND);
+	gl_state.active_texture(GL_TEXTURE0);
+
+	//----- one draw per run of matching blend mode + texture -----
+	// (layers only order runs; adjacent runs in different layers with the same state merge)
+	GLuint bound_texture = 0;
+	for (size_t begin = 0; begin < submissions.size(); ) {
+		Blend blend = submissions[begin].blend;
+		GLuint texture = submissions[begin].texture;
+		size_t end = begin + 1;
+		while (end < submissions.size() && submissions[end].blend == blend && submissions[end].texture == texture) ++end;
+
+		if (blend == Blend::Alpha) gl_state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		else if (blend == Blend::Additive) gl_state.blend_func(GL_SRC_ALPHA, GL_ONE);
+		else gl_state.blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); //Blend::Premultiplied
+
+		if (texture != bound_texture || texture_binds == 0) {
+			gl_state.bind_texture(GL_TEXTURE_2D, texture);
+			bound_texture = texture;
+			++texture_binds;
+		}
+
+		glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei((end - begin) * RectangleIndices), GL_UNSIGNED_INT,
+			(GLbyte *)0 + begin * RectangleIndices * sizeof(GLuint), base_vertex);
+		++draw_calls;
+
+		begin = end;
+	}
+	//(program, vertex array, and texture stay bound -- gl_state will skip re-binding them next frame)
+
+	vertex_buffer.end_frame();
+	submissions.clear();
+
+	GL_ERRORS();
+}
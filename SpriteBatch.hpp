@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ColorTextureProgram.hpp"
+#include "StreamingBuffer.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * SpriteBatch collects textured quads ("sprites") over a frame and draws them in as few calls as it can.
+ *
+ * Submissions are (stably) sorted by layer, then blend mode, then texture; each run that shares a
+ * blend mode and texture becomes one glDrawElementsBaseVertex over a single streamed vertex buffer.
+ * Sprites cut from one SpriteAtlas share a texture, so they cost no extra draws or binds.
+ *
+ * NOTE: within a layer, sprites are only drawn in submission order relative to others with the same
+ *  blend mode and texture -- put things that must overlap in a particular order on different layers.
+ */
+
+struct SpriteBatch {
+	SpriteBatch();
+	~SpriteBatch();
+	SpriteBatch(SpriteBatch const &) = delete;
+	SpriteBatch &operator=(SpriteBatch const &) = delete;
+
+	enum class Blend : uint8_t {
+		Alpha, //straight alpha: src * a + dst * (1 - a)
+		Additive, //src * a + dst
+		Premultiplied, //src + dst * (1 - a)
+	};
+
+	//An axis-aligned quad showing [uv_min,uv_max] of a texture, tinted by color:
+	struct Sprite {
+		glm::vec2 center;
+		glm::vec2 radius;
+		glm::vec2 uv_min;
+		glm::vec2 uv_max;
+		glm::u8vec4 color;
+	};
+
+	//queue a sprite for the next draw(); lower layers are drawn first:
+	void submit(GLuint texture, Blend blend, int32_t layer, Sprite const &sprite);
+
+	//draw (and then clear) everything queued, in court coordinates:
+	// (binds its own program, texture unit zero, and blend state; enables GL_BLEND)
+	// (COURT_TO_CLIP comes from the per-frame uniforms -- see frame_uniforms.hpp)
+	void draw();
+
+	//Vertex format written to the GPU:
+	struct Vertex {
+		glm::vec2 Position;
+		glm::vec2 TexCoord;
+		glm::u8vec4 Color;
+	};
+	static_assert(sizeof(Vertex) == 4*2 + 4*2 + 1*4, "SpriteBatch::Vertex should be packed");
+
+	struct Submission {
+		int32_t layer;
+		Blend blend;
+		GLuint texture;
+		Sprite sprite;
+	};
+	std::vector< Submission > submissions; //queued
+
+	std::vector< Vertex > vertices; //(kept between frames to avoid reallocating)
+
+	//Textured variant of the color/texture program:
+	ColorTextureProgram program = ColorTextureProgram(ColorTextureProgram::Textured);
+
+	StreamingBuffer vertex_buffer;
+	GLuint vertex_array = 0;
+
+	//what the last draw() did:
+	uint32_t draw_calls = 0;
+	uint32_t texture_binds = 0; //(texture changes between runs, counting the first)
+};
@@ -0,0 +1,113 @@
+#include "StreamingBuffer.hpp"
+
+#include "GLStateCache.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+StreamingBuffer::StreamingBuffer(GLenum target_, size_t frame_capacity_, uint32_t frames_)
+	: target(target_), frame_capacity(frame_capacity_), frames(std::max(1U, frames_)) {
+	fences.assign(frames, nullptr);
+
+	glGenBuffers(1, &buffer);
+	gl_state.bind_buffer(target, buffer);
+	glBufferData(target, frame_capacity * frames, nullptr, GL_STREAM_DRAW);
+	gl_state.bind_buffer(target, 0);
+
+	GL_ERRORS();
+}
+
+StreamingBuffer::~StreamingBuffer() {
+	for (auto &fence : fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+	gl_state.delete_buffer(buffer);
+	buffer = 0;
+}
+
+void StreamingBuffer::grow(size_t capacity) {
+	//new storage for every region; draws already issued keep reading the old storage, so nothing
+	// needs to wait -- and old fences are dropped since they guard storage that is no longer ours:
+	grows += 1;
+	while (frame_capacity < capacity) frame_capacity *= 2;
+	gl_state.bind_buffer(target, buffer);
+	glBufferData(target, frame_capacity * frames, nullptr, GL_STREAM_DRAW);
+	for (auto &fence : fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+void StreamingBuffer::begin_frame(size_t reserve) {
+	frame = (frame + 1) % frames;
+	used = 0;
+
+	if (reserve > frame_capacity) {
+		grow(reserve);
+		return; //(fresh storage, so nothing to wait for)
+	}
+
+	GLsync &fence = fences[frame];
+	if (!fence) return;
+
+	//usually the GPU finished this region long ago, so poll first:
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED) {
+		stalls += 1;
+		do {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); //1ms
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	if (result == GL_WAIT_FAILED) {
+		std::cerr << "WARNING: glClientWaitSync failed; finishing instead." << std::endl;
+		glFinish();
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+GLintptr StreamingBuffer::write(void const *data, size_t size, size_t alignment) {
+	assert(alignment > 0);
+	size_t region = frame * frame_capacity;
+	size_t offset = (region + used + alignment - 1) / alignment * alignment;
+
+	if (offset + size > region + frame_capacity) {
+		//out of room: grow (with slack, so this doesn't happen every frame).
+		//Earlier writes this frame would be lost along with the old storage, so that's a usage error:
+		assert(used == 0 && "StreamingBuffer grew after a write this frame -- reserve the frame's total in begin_frame()");
+		if (used != 0) {
+			std::cerr << "WARNING: StreamingBuffer grew after a write this frame; earlier data this frame is lost." << std::endl;
+		}
+		grow(2 * (size + alignment));
+		region = frame * frame_capacity;
+		offset = (region + alignment - 1) / alignment * alignment;
+	}
+
+	gl_state.bind_buffer(target, buffer);
+
+	if (size > 0) {
+		void *dst = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		if (dst) {
+			std::memcpy(dst, data, size);
+			if (glUnmapBuffer(target) != GL_TRUE) {
+				//(contents were lost -- e.g., display mode change -- so write them the slow way)
+				glBufferSubData(target, offset, size, data);
+			}
+		} else {
+			glBufferSubData(target, offset, size, data);
+		}
+	}
+
+	used = offset + size - region;
+	return GLintptr(offset);
+}
+
+void StreamingBuffer::end_frame() {
+	GLsync &fence = fences[frame];
+	if (fence) glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
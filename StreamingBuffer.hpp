@@ -0,0 +1,63 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * StreamingBuffer is a ring buffer for data that is rewritten every frame (e.g., vertices).
+ *
+ * The buffer is split into one region per frame in flight. Each frame writes into its own region
+ * with unsynchronized glMapBufferRange, so the driver never has to reallocate storage or stall
+ * on draws that are still reading older data. Instead, a fence is placed at the end of each
+ * frame, and the region is only reused once the GPU has passed that fence.
+ *
+ * Usage, once per frame:
+ *   begin_frame(reserve); //'reserve' is the total bytes this frame will write (if more than one write)
+ *   GLintptr offset = write(data, size, alignment); //as many times as fit in the reserved space
+ *   ...draw using data at 'offset' in 'buffer'...
+ *   end_frame();
+ *
+ * NOTE: growing gives the buffer fresh storage, which loses anything already written this frame --
+ *  so only the first write of a frame may grow it. Frames that write more than once must fit
+ *  (with alignment padding) in what begin_frame reserved.
+ */
+
+struct StreamingBuffer {
+	//'frame_capacity' is the starting size (bytes) of each frame's region; it grows as needed:
+	StreamingBuffer(GLenum target = GL_ARRAY_BUFFER, size_t frame_capacity = 256 * 1024, uint32_t frames = 3);
+	~StreamingBuffer();
+	StreamingBuffer(StreamingBuffer const &) = delete;
+	StreamingBuffer &operator=(StreamingBuffer const &) = delete;
+
+	//move to the next frame's region, waiting (only) if the GPU may still be reading it;
+	// grows regions to at least 'reserve' bytes first:
+	void begin_frame(size_t reserve = 0);
+
+	//copy 'size' bytes into the current frame's region; returns the offset (from the start of 'buffer')
+	// they were written at, which will be a multiple of 'alignment':
+	// (leaves 'buffer' bound to 'target', via gl_state)
+	//NOTE: if this doesn't fit, the buffer grows -- which is only allowed on the frame's first write
+	GLintptr write(void const *data, size_t size, size_t alignment = 16);
+
+	//fence the current frame's region; call after issuing every draw that reads it:
+	void end_frame();
+
+	GLenum target;
+	GLuint buffer = 0;
+	size_t frame_capacity; //bytes per region
+	uint32_t frames; //regions in the ring
+
+	uint32_t frame = 0; //current region
+	size_t used = 0; //bytes written into current region
+	std::vector< GLsync > fences; //per region; nullptr if not in flight
+
+	//how often the CPU actually had to wait for the GPU (should stay at zero, or grow rarely):
+	uint32_t stalls = 0;
+	uint32_t grows = 0;
+
+	//reallocate with regions of at least 'capacity' bytes (fresh storage; drops all fences):
+	void grow(size_t capacity);
+};
@@ -0,0 +1,145 @@
+#include "TextureStreamer.hpp"
+
+#include "GLStateCache.hpp"
+#include "Packfile.hpp"
+#include "ThreadPool.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+std::shared_ptr< TextureStreamer > TextureStreamer::shared;
+
+TextureStreamer::TextureStreamer(size_t frame_budget_) : frame_budget(frame_budget_) {
+}
+
+TextureStreamer::~TextureStreamer() {
+	//(decodes still in flight finish into their futures, which nobody will read)
+	for (auto &entry : entries) {
+		if (entry.texture) gl_state.delete_texture(entry.texture);
+		entry.texture = 0;
+	}
+}
+
+TextureStreamer::Handle TextureStreamer::request(std::string const &name) {
+	auto f = handles.find(name);
+	if (f != handles.end()) return f->second;
+
+	//the job keeps the packfile alive (and reads it -- Packfile::get is thread-safe):
+	std::shared_ptr< Packfile > pack = Packfile::assets;
+	if (pack && !pack->contains(name)) pack.reset();
+
+	entries.emplace_back();
+	Entry &entry = entries.back();
+	entry.name = name;
+	entry.decoded = ThreadPool::shared().enqueue([pack, name]() {
+		CachedImage image;
+		if (pack) {
+			Packfile::Span png = pack->get(name);
+			load_png_cached(png.data, png.size, name, LowerLeftOrigin, false, &image);
+		} else {
+			load_png_cached(name, LowerLeftOrigin, false, &image);
+		}
+		return image;
+	});
+
+	Handle handle = Handle(entries.size());
+	handles.emplace(name, handle);
+	return handle;
+}
+
+GLuint TextureStreamer::texture(Handle handle, GLuint fallback) const {
+	if (handle == 0 || handle > entries.size()) return fallback;
+	Entry const &entry = entries[handle - 1];
+	return (entry.state == Entry::Ready ? entry.texture : fallback);
+}
+
+bool TextureStreamer::ready(Handle handle) const {
+	return handle != 0 && handle <= entries.size() && entries[handle - 1].state == Entry::Ready;
+}
+
+uint32_t TextureStreamer::pending() const {
+	uint32_t count = 0;
+	for (auto const &entry : entries) {
+		if (entry.state == Entry::Decoding || entry.state == Entry::Uploading) ++count;
+	}
+	return count;
+}
+
+void TextureStreamer::update() {
+	uploaded_last_frame = 0;
+
+	//----- collect finished decodes (without waiting for unfinished ones) -----
+	for (auto &entry : entries) {
+		if (entry.state != Entry::Decoding) continue;
+		if (entry.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+		try {
+			CachedImage image = entry.decoded.get();
+			if (image.size().x == 0 || image.size().y == 0) throw std::runtime_error("image is empty");
+			entry.size = image.size();
+			entry.image = std::move(image);
+			entry.state = Entry::Uploading;
+		} catch (std::exception &e) {
+			std::cerr << "WARNING: failed to load texture '" << entry.name << "': " << e.what() << std::endl;
+			entry.state = Entry::Failed;
+		}
+	}
+
+	//----- upload rows, oldest request first, until the budget runs out -----
+	size_t budget = frame_budget;
+	bool began = false;
+	for (auto &entry : entries) {
+		if (entry.state != Entry::Uploading) continue;
+		size_t row_bytes = size_t(entry.size.x) * sizeof(glm::u8vec4);
+		//(a row wider than the whole budget still goes, but only as the frame's first upload)
+		if (budget < row_bytes && uploaded_last_frame > 0) break;
+
+		if (!began) {
+			if (!unpack_buffer) unpack_buffer.reset(new StreamingBuffer(GL_PIXEL_UNPACK_BUFFER, frame_budget));
+			//(several writes per frame, which the budget keeps within frame_budget bytes --
+			// except an over-wide row, which is always the frame's first and only write)
+			unpack_buffer->begin_frame(frame_budget);
+			began = true;
+		}
+
+		if (entry.texture == 0) {
+			//allocate storage (nothing may be bound to GL_PIXEL_UNPACK_BUFFER, or 'nullptr' would be an offset into it):
+			gl_state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glGenTextures(1, &entry.texture);
+			gl_state.bind_texture(GL_TEXTURE_2D, entry.texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, entry.size.x, entry.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		uint32_t rows = uint32_t(std::max< size_t >(1, std::min< size_t >(entry.size.y - entry.uploaded_rows, budget / row_bytes)));
+		size_t bytes = rows * row_bytes;
+
+		//copy into the unpack buffer, then have GL read the texture's rows from there:
+		GLintptr offset = unpack_buffer->write(entry.image.levels[0].pixels + size_t(entry.uploaded_rows) * entry.size.x, bytes, sizeof(glm::u8vec4));
+		gl_state.bind_texture(GL_TEXTURE_2D, entry.texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, entry.uploaded_rows, entry.size.x, rows, GL_RGBA, GL_UNSIGNED_BYTE, (GLbyte *)0 + offset);
+
+		entry.uploaded_rows += rows;
+		budget -= std::min(budget, bytes);
+		uploaded_last_frame += bytes;
+
+		if (entry.uploaded_rows == entry.size.y) {
+			entry.state = Entry::Ready;
+			entry.image = CachedImage(); //(unmaps or frees the pixels)
+		}
+		if (budget == 0) break;
+	}
+
+	if (began) {
+		//other code uploads from client memory, which only works with no unpack buffer bound:
+		gl_state.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		unpack_buffer->end_frame();
+		GL_ERRORS();
+	}
+	uploaded_total += uploaded_last_frame;
+}
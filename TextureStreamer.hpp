@@ -0,0 +1,78 @@
+#pragma once
+
+#include "GL.hpp"
+#include "StreamingBuffer.hpp"
+#include "texture_cache.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * TextureStreamer loads PNG textures without ever making a frame wait for them.
+ *
+ * request() returns a handle right away and queues the PNG to be decoded on ThreadPool::shared()
+ * (with load_png_cached -- so on warm starts, "decoding" is mapping a texture-cache entry). Once decoded, update() -- called once per frame by main() -- copies rows of
+ * it into a pixel-unpack buffer (a fenced StreamingBuffer, so the copy never waits on the GPU) and has
+ * GL pull them into the texture from there, stopping once 'frame_budget' bytes have gone this frame.
+ *
+ * Until a texture is completely uploaded, texture() returns the caller's fallback (e.g., a white
+ * texture) instead, so drawing code never has to check.
+ */
+
+struct TextureStreamer {
+	//'frame_budget' is the most bytes of pixels uploaded per frame (at least one row always goes):
+	explicit TextureStreamer(size_t frame_budget = 4 * 1024 * 1024);
+	~TextureStreamer();
+	TextureStreamer(TextureStreamer const &) = delete;
+	TextureStreamer &operator=(TextureStreamer const &) = delete;
+
+	typedef uint32_t Handle; //0 is never returned
+
+	//start loading 'name' -- an entry in Packfile::assets if it has one, a file path otherwise:
+	// (requesting the same name again returns the same handle)
+	Handle request(std::string const &name);
+
+	//the texture if it is ready, 'fallback' if it is still loading (or failed to load):
+	GLuint texture(Handle handle, GLuint fallback) const;
+	bool ready(Handle handle) const;
+
+	//collect finished decodes and upload (up to frame_budget bytes of) pixels:
+	// (call once per frame, with the GL context current)
+	void update();
+
+	//textures still decoding or uploading:
+	uint32_t pending() const;
+
+	size_t frame_budget;
+
+	//----- internals -----
+	struct Entry {
+		std::string name;
+		enum State { Decoding, Uploading, Ready, Failed } state = Decoding;
+		std::future< CachedImage > decoded; //(while Decoding)
+		glm::uvec2 size = glm::uvec2(0);
+		CachedImage image; //(while Uploading)
+		uint32_t uploaded_rows = 0;
+		GLuint texture = 0;
+	};
+	std::vector< Entry > entries; //handle - 1 -> entry
+	std::unordered_map< std::string, Handle > handles; //name -> handle
+
+	//pixel-unpack ring buffer (made on first upload):
+	std::unique_ptr< StreamingBuffer > unpack_buffer;
+
+	//bytes uploaded by the last update() (and in total):
+	size_t uploaded_last_frame = 0;
+	size_t uploaded_total = 0;
+
+	//streamer used by modes to load art (set up in main(), before the first Mode):
+	static std::shared_ptr< TextureStreamer > shared;
+};
@@ -0,0 +1,99 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+ThreadPool::ThreadPool(uint32_t count) {
+	if (count == 0) {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		count = (hardware > 1 ? hardware - 1 : 1);
+	}
+	workers.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		workers.emplace_back([this](){
+			while (true) {
+				std::function< void() > job;
+				{
+					std::unique_lock< std::mutex > lock(mutex);
+					jobs_cv.wait(lock, [this](){ return quit || !jobs.empty(); });
+					if (jobs.empty()) return; //only happens when quitting
+					job = std::move(jobs.front());
+					jobs.pop_front();
+				}
+				job();
+			}
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	jobs_cv.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::push(std::function< void() > &&job) {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		jobs.emplace_back(std::move(job));
+	}
+	jobs_cv.notify_one();
+}
+
+void ThreadPool::parallel_for(size_t count, std::function< void(size_t) > const &job) {
+	if (count == 0) return;
+
+	//shared by the caller and any helpers; helpers may outlive this call (if they start late),
+	// so it is reference counted. Late helpers never touch 'job', since no indices remain.
+	struct State {
+		std::function< void(size_t) > const *job = nullptr;
+		size_t count = 0;
+		std::atomic< size_t > next{0};
+		std::atomic< size_t > done{0};
+		std::mutex mutex;
+		std::condition_variable done_cv;
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared< State >();
+	state->job = &job;
+	state->count = count;
+
+	auto run = [](State &state) {
+		while (true) {
+			size_t i = state.next.fetch_add(1);
+			if (i >= state.count) return;
+			try {
+				(*state.job)(i);
+			} catch (...) {
+				std::unique_lock< std::mutex > lock(state.mutex);
+				if (!state.error) state.error = std::current_exception();
+			}
+			if (state.done.fetch_add(1) + 1 == state.count) {
+				std::unique_lock< std::mutex > lock(state.mutex);
+				state.done_cv.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min(count - 1, workers.size());
+	for (size_t h = 0; h < helpers; ++h) {
+		push([state,run](){ run(*state); });
+	}
+
+	run(*state);
+
+	std::unique_lock< std::mutex > lock(state->mutex);
+	state->done_cv.wait(lock, [&state](){ return state->done.load() == state->count; });
+	if (state->error) std::rethrow_exception(state->error);
+}
+
+ThreadPool &ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * ThreadPool runs small jobs on a fixed set of worker threads.
+ */
+
+struct ThreadPool {
+	//count == 0 means "one worker per hardware thread, less the calling thread":
+	explicit ThreadPool(uint32_t count = 0);
+	~ThreadPool();
+
+	//queue up a job; its result (or exception) is delivered through the returned future:
+	template< typename F >
+	auto enqueue(F &&f) -> std::future< decltype(f()) >;
+
+	//run job(i) for every i in [0,count), spread over the workers *and* the calling thread.
+	// returns once all jobs are done; rethrows the first exception any job threw.
+	//NOTE: because the caller does work too, this is safe to call from inside a job.
+	void parallel_for(size_t count, std::function< void(size_t) > const &job);
+
+	uint32_t size() const { return uint32_t(workers.size()); }
+
+	//pool shared by helpers that want some parallelism (created on first use):
+	static ThreadPool &shared();
+
+	//----- internals -----
+	void push(std::function< void() > &&job);
+
+	std::vector< std::thread > workers;
+	std::deque< std::function< void() > > jobs;
+	std::mutex mutex;
+	std::condition_variable jobs_cv;
+	bool quit = false;
+};
+
+template< typename F >
+auto ThreadPool::enqueue(F &&f) -> std::future< decltype(f()) > {
+	//std::function needs a copyable target, so the (move-only) task lives in a shared_ptr:
+	auto task = std::make_shared< std::packaged_task< decltype(f())() > >(std::forward< F >(f));
+	std::future< decltype(f()) > ret = task->get_future();
+	push([task](){ (*task)(); });
+	return ret;
+}
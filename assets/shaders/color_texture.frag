@@ -0,0 +1,26 @@
+#version 330
+//features: TEXTURED, INSTANCED, SDF (see ColorTextureProgram.hpp)
+#ifdef TEXTURED
+uniform sampler2D TEX;
+#endif
+in vec4 color;
+#if defined(TEXTURED) || defined(SDF)
+//with SDF, texCoord is the position within the shape, [-1,1]x[-1,1]:
+in vec2 texCoord;
+#endif
+out vec4 fragColor;
+void main() {
+	fragColor = color;
+#ifdef TEXTURED
+#ifdef SDF
+	fragColor *= texture(TEX, 0.5 * texCoord + 0.5);
+#else
+	fragColor *= texture(TEX, texCoord);
+#endif
+#endif
+#ifdef SDF
+	//antialiased ellipse inscribed in the shape:
+	float d = length(texCoord) - 1.0;
+	fragColor.a *= clamp(0.5 - d / max(fwidth(d), 1e-4), 0.0, 1.0);
+#endif
+}
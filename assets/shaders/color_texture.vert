@@ -0,0 +1,43 @@
+#version 330
+//features: TEXTURED, INSTANCED, SDF (see ColorTextureProgram.hpp)
+//per-frame values shared by every program (see frame_uniforms.hpp):
+layout(std140) uniform Frame {
+	mat4 COURT_TO_CLIP;
+	float TIME;
+	vec2 RESOLUTION;
+};
+//placement of whatever is being drawn (identity unless set):
+uniform mat4 OBJECT_TO_COURT = mat4(1.0);
+in vec4 Position;
+#ifdef INSTANCED
+//Position is a corner of the [-1,1]x[-1,1] quad; each instance places and colors it:
+in vec2 Center;
+in vec2 Radius;
+#endif
+in vec4 Color;
+out vec4 color;
+#if defined(TEXTURED) || defined(SDF)
+#ifndef INSTANCED
+in vec2 TexCoord;
+#endif
+out vec2 texCoord;
+#endif
+void main() {
+#ifdef INSTANCED
+	gl_Position = COURT_TO_CLIP * (OBJECT_TO_COURT * vec4(Center + Position.xy * Radius, 0.0, 1.0));
+#else
+	gl_Position = COURT_TO_CLIP * (OBJECT_TO_COURT * Position);
+#endif
+	color = Color;
+#if defined(TEXTURED) || defined(SDF)
+#ifdef INSTANCED
+#ifdef SDF
+	texCoord = Position.xy;
+#else
+	texCoord = 0.5 * Position.xy + 0.5;
+#endif
+#else
+	texCoord = TexCoord;
+#endif
+#endif
+}
@@ -0,0 +1,68 @@
+#include "cache_files.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+	#include <sys/types.h>
+	#include <unistd.h>
+#endif
+
+static std::string unique_suffix() {
+	static std::atomic< uint32_t > counter(0);
+	#ifdef _WIN32
+	unsigned long pid = GetCurrentProcessId();
+	#else
+	unsigned long pid = (unsigned long)getpid();
+	#endif
+	return ".tmp." + std::to_string(pid) + "." + std::to_string(counter.fetch_add(1));
+}
+
+void make_cache_directory(std::string const &path) {
+	#ifdef _WIN32
+	_mkdir(path.c_str());
+	#else
+	mkdir(path.c_str(), 0755);
+	#endif
+	//(errors -- e.g., already exists -- will show up when writing, if they matter)
+}
+
+//move 'from' over 'to', replacing any existing file:
+static bool replace_file(std::string const &from, std::string const &to) {
+	#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+	#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+	#endif
+}
+
+bool write_cache_file(std::string const &filename, std::vector< std::pair< void const *, size_t > > const &pieces) {
+	std::string temp = filename + unique_suffix();
+	{
+		std::ofstream out(temp, std::ios::binary);
+		for (auto const &piece : pieces) {
+			out.write(reinterpret_cast< char const * >(piece.first), piece.second);
+		}
+		//(close flushes, so errors from the last writes -- like a full disk -- only show up after it)
+		out.close();
+		if (out.fail()) {
+			std::cerr << "WARNING: failed to write cache file '" << temp << "'." << std::endl;
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+	if (!replace_file(temp, filename)) {
+		//(on Windows this fails if another process has the file mapped -- but then it's already there)
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+/*
+ * Helpers shared by the on-disk caches (texture_cache, gl_compile_program's program cache).
+ */
+
+//create a directory (if it doesn't exist already):
+void make_cache_directory(std::string const &path);
+
+//write 'pieces' (back-to-back) to 'filename' by writing a temporary file and renaming it into place,
+// so that readers never see a half-written file -- even with several processes writing at once.
+//returns false if the entry wasn't put in place (warning on std::cerr if the temporary file couldn't be written;
+// a failed rename is quiet, since on Windows that usually means another process has the entry open).
+bool write_cache_file(std::string const &filename, std::vector< std::pair< void const *, size_t > > const &pieces);
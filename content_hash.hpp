@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fast 64-bit (non-cryptographic) hash of a block of bytes, used to key on-disk caches.
+ */
+
+inline uint64_t content_hash(void const *data, size_t length, uint64_t seed = 0) {
+	uint8_t const *bytes = reinterpret_cast< uint8_t const * >(data);
+	const uint64_t k = 0x9E3779B97F4A7C15ULL;
+	uint64_t h = seed ^ (uint64_t(length) * k);
+	auto mix = [&](uint64_t word) {
+		h ^= word * 0xBF58476D1CE4E5B9ULL;
+		h = ((h << 31) | (h >> 33)) * k;
+	};
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, 8);
+		mix(word);
+	}
+	if (i < length) {
+		uint64_t word = 0;
+		std::memcpy(&word, bytes + i, length - i);
+		mix(word);
+	}
+	//final avalanche (splitmix64):
+	h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27; h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return h;
+}
+
+inline uint64_t content_hash(std::string const &str, uint64_t seed = 0) {
+	return content_hash(str.data(), str.size(), seed);
+}
+
+//16 lowercase hex digits, for making file names out of hashes:
+inline std::string content_hash_hex(uint64_t hash) {
+	static char const digits[] = "0123456789abcdef";
+	std::string ret(16, '0');
+	for (int i = 15; i >= 0; --i) {
+		ret[i] = digits[hash & 0xf];
+		hash >>= 4;
+	}
+	return ret;
+}
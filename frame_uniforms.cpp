@@ -0,0 +1,21 @@
+#include "frame_uniforms.hpp"
+
+#include "GLStateCache.hpp"
+#include "gl_errors.hpp"
+
+void upload_frame_uniforms(FrameUniforms const &frame) {
+	//NOTE: never deleted (it goes away with the context):
+	static GLuint buffer = 0;
+	if (buffer == 0) {
+		glGenBuffers(1, &buffer);
+	}
+
+	gl_state.bind_buffer(GL_UNIFORM_BUFFER, buffer);
+	//re-specifying the whole (tiny) buffer lets the driver hand back fresh storage instead of
+	// waiting for last frame's draws to finish reading the old contents:
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), &frame, GL_STREAM_DRAW);
+	//(glBindBufferBase also sets the generic GL_UNIFORM_BUFFER binding -- to the same buffer, so gl_state stays right)
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameUniformsBinding, buffer);
+
+	GL_ERRORS();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/*
+ * Per-frame values every program can read, from one uniform buffer that is updated once per frame.
+ *
+ * Shaders declare the block as:
+ *   layout(std140) uniform Frame {
+ *     mat4 COURT_TO_CLIP;
+ *     float TIME;
+ *     vec2 RESOLUTION;
+ *   };
+ * and gl_compile_program points any program with a 'Frame' block at FrameUniformsBinding,
+ * so nothing needs to be set per program.
+ */
+
+//Mirror of the 'Frame' block in std140 layout:
+struct FrameUniforms {
+	glm::mat4 COURT_TO_CLIP = glm::mat4(1.0f); //court (world) coordinates -> clip coordinates
+	float TIME = 0.0f; //seconds the current mode has been running
+	float _pad0 = 0.0f; //(std140 aligns vec2 to 8 bytes)
+	glm::vec2 RESOLUTION = glm::vec2(0.0f); //drawable size, in pixels
+};
+static_assert(sizeof(FrameUniforms) == 80, "FrameUniforms should match the std140 'Frame' block");
+static_assert(offsetof(FrameUniforms, TIME) == 64 && offsetof(FrameUniforms, RESOLUTION) == 72, "FrameUniforms should match the std140 'Frame' block");
+
+//Name of the block in shaders, and the uniform buffer binding point it is read from:
+constexpr char const *FrameUniformsBlock = "Frame";
+constexpr GLuint FrameUniformsBinding = 0;
+
+//upload 'frame' to the shared uniform buffer (and bind it to FrameUniformsBinding); call once per frame, before drawing:
+void upload_frame_uniforms(FrameUniforms const &frame);
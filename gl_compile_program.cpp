@@ -1,62 +1,306 @@
 #include "gl_compile_program.hpp"
 
+#include "cache_files.hpp"
+#include "content_hash.hpp"
+#include "frame_uniforms.hpp"
+#include "MappedFile.hpp"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <thread>
 #include <iostream>
 
-static GLuint gl_compile_shader(GLenum type, std::string const &source) {
+std::string gl_program_cache_directory = "program-cache";
+GLProgramCacheStats gl_program_cache_stats;
+
+//------ extensions (core in 4.1+, so not in GL.hpp) ------
+
+//ARB_get_program_binary:
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void (APIENTRY *PFNGLGETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRY *PFNGLPROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRY *PFNGLPROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+
+//KHR_parallel_shader_compile (or the identical ARB version):
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRY *PFNGLMAXSHADERCOMPILERTHREADS)(GLuint count);
+
+struct ProgramExtensions {
+	//program binaries:
+	PFNGLGETPROGRAMBINARY GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARY ProgramBinary = nullptr;
+	PFNGLPROGRAMPARAMETERI ProgramParameteri = nullptr;
+	uint64_t driver_hash = 0; //hash of vendor/renderer/version strings
+	bool program_binary = false;
+
+	//parallel compile -- if set, GL_COMPLETION_STATUS_KHR can be queried without waiting:
+	bool parallel_compile = false;
+};
+
+//looked up on first use (there must be a current context by then):
+static ProgramExtensions const &program_extensions() {
+	static ProgramExtensions extensions = [](){
+		ProgramExtensions ret;
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+		//program binaries:
+		GLint formats = 0;
+		if ((major > 4 || (major == 4 && minor >= 1)) || SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+			//some drivers expose the extension but no formats it can actually save:
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		}
+		if (formats > 0) {
+			ret.GetProgramBinary = (PFNGLGETPROGRAMBINARY)SDL_GL_GetProcAddress("glGetProgramBinary");
+			ret.ProgramBinary = (PFNGLPROGRAMBINARY)SDL_GL_GetProcAddress("glProgramBinary");
+			ret.ProgramParameteri = (PFNGLPROGRAMPARAMETERI)SDL_GL_GetProcAddress("glProgramParameteri");
+			if (ret.GetProgramBinary && ret.ProgramBinary && ret.ProgramParameteri) {
+				//binaries are only valid for the driver that made them:
+				for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+					char const *str = reinterpret_cast< char const * >(glGetString(name));
+					ret.driver_hash = content_hash(std::string(str ? str : ""), ret.driver_hash);
+				}
+				ret.program_binary = true;
+			}
+		}
+
+		//parallel compile:
+		PFNGLMAXSHADERCOMPILERTHREADS MaxShaderCompilerThreads = nullptr;
+		if (SDL_GL_ExtensionSupported("GL_KHR_parallel_shader_compile")) {
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADS)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR");
+		} else if (SDL_GL_ExtensionSupported("GL_ARB_parallel_shader_compile")) {
+			MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADS)SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB");
+		}
+		if (MaxShaderCompilerThreads) {
+			MaxShaderCompilerThreads(0xffffffff); //let the driver pick how many threads to use
+			ret.parallel_compile = true;
+		}
+		return ret;
+	}();
+	return extensions;
+}
+
+//Cache file layout: this header, then the program binary.
+struct ProgramCacheHeader {
+	char magic[8]; //"GLPROGBN"
+	uint32_t version;
+	uint32_t binary_format; //as reported by glGetProgramBinary
+	uint64_t key; //hash of sources + driver strings
+	uint64_t binary_size;
+};
+static_assert(sizeof(ProgramCacheHeader) == 32, "cache header is packed");
+static constexpr uint32_t ProgramCacheVersion = 1;
+
+//try to make a program from a cache entry; returns 0 if there is no (usable) entry:
+static GLuint load_cached_program(ProgramExtensions const &extensions, std::string const &entry, uint64_t key) {
+	MappedFile mapped;
+	try {
+		mapped = MappedFile(entry);
+	} catch (std::exception &) {
+		return 0; //no entry yet
+	}
+	ProgramCacheHeader header;
+	if (mapped.size() < sizeof(header)) return 0;
+	std::memcpy(&header, mapped.data(), sizeof(header));
+	if (std::memcmp(header.magic, "GLPROGBN", 8) != 0
+	 || header.version != ProgramCacheVersion
+	 || header.key != key
+	 || header.binary_size != mapped.size() - sizeof(header)) {
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	extensions.ProgramBinary(program, header.binary_format, mapped.data() + sizeof(header), GLsizei(header.binary_size));
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		//(drivers may refuse binaries after e.g. an update that didn't change the version string)
+		glDeleteProgram(program);
+		gl_program_cache_stats.rejected += 1;
+		return 0;
+	}
+	return program;
+}
+
+static void save_cached_program(ProgramExtensions const &extensions, std::string const &entry, uint64_t key, GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector< uint8_t > binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	extensions.GetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0) return;
+
+	ProgramCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "GLPROGBN", 8);
+	header.version = ProgramCacheVersion;
+	header.binary_format = format;
+	header.key = key;
+	header.binary_size = uint64_t(written);
+
+	make_cache_directory(gl_program_cache_directory);
+	write_cache_file(entry, {
+		{ &header, sizeof(header) },
+		{ binary.data(), size_t(written) },
+	});
+}
+
+//------ compilation ------
+
+static void print_info_log(GLuint object, bool is_program) {
+	GLint info_log_length = 0;
+	if (is_program) glGetProgramiv(object, GL_INFO_LOG_LENGTH, &info_log_length);
+	else glGetShaderiv(object, GL_INFO_LOG_LENGTH, &info_log_length);
+	std::vector< GLchar > info_log(std::max(1, info_log_length), 0);
+	GLsizei length = 0;
+	if (is_program) glGetProgramInfoLog(object, GLint(info_log.size()), &length, &info_log[0]);
+	else glGetShaderInfoLog(object, GLint(info_log.size()), &length, &info_log[0]);
+	std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+}
+
+//starts compiling a shader; status is checked later (asking right away would wait for the compiler):
+static GLuint gl_submit_shader(GLenum type, std::string const &source) {
 	GLuint shader = glCreateShader(type);
 	GLchar const *str = source.c_str();
 	GLint length = GLint(source.size());
 	glShaderSource(shader, 1, &str, &length);
 	glCompileShader(shader);
-	GLint compile_status = GL_FALSE;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
-	if (compile_status != GL_TRUE) {
-		std::cerr << "Failed to compile shader." << std::endl;
-		GLint info_log_length = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
-		std::vector< GLchar > info_log(info_log_length, 0);
-		GLsizei length = 0;
-		glGetShaderInfoLog(shader, GLint(info_log.size()), &length, &info_log[0]);
-		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-		glDeleteShader(shader);
-		throw std::runtime_error("Failed to compile shader.");
-	}
 	return shader;
 }
 
-GLuint gl_compile_program(
-	std::string const &vertex_shader_source,
-	std::string const &fragment_shader_source
-	) {
+std::vector< GLuint > gl_compile_programs(std::vector< GLProgramSources > const &sources) {
+	auto before = std::chrono::high_resolution_clock::now();
 
-	GLuint vertex_shader = gl_compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
-	GLuint fragment_shader = gl_compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+	ProgramExtensions const &extensions = program_extensions();
+	bool use_cache = extensions.program_binary && !gl_program_cache_directory.empty();
 
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
+	std::vector< GLuint > programs(sources.size(), 0);
 
-	//shaders are reference counted so this makes sure they are freed after program is deleted:
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+	//programs being built from source:
+	struct Pending {
+		size_t index;
+		std::string entry; //cache entry to write ("" if not caching)
+		uint64_t key = 0;
+		GLuint vertex_shader = 0;
+		GLuint fragment_shader = 0;
+		bool done = false;
+	};
+	std::vector< Pending > pending;
 
-	//link the shader program and throw errors if linking fails:
-	glLinkProgram(program);
-	GLint link_status = GL_FALSE;
-	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
-	if (link_status != GL_TRUE) {
-		std::cerr << "Failed to link shader program." << std::endl;
-		GLint info_log_length = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
-		std::vector< GLchar > info_log(info_log_length, 0);
-		GLsizei length = 0;
-		glGetProgramInfoLog(program, GLint(info_log.size()), &length, &info_log[0]);
-		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+	//(1) cached binaries:
+	for (size_t i = 0; i < sources.size(); ++i) {
+		Pending p;
+		p.index = i;
+		if (use_cache) {
+			p.key = content_hash(sources[i].vertex, extensions.driver_hash);
+			p.key = content_hash(sources[i].fragment, p.key);
+			p.entry = gl_program_cache_directory + "/" + content_hash_hex(p.key) + ".bin";
+
+			programs[i] = load_cached_program(extensions, p.entry, p.key);
+			if (programs[i] != 0) {
+				gl_program_cache_stats.hits += 1;
+				continue;
+			}
+		}
+		gl_program_cache_stats.misses += 1;
+		pending.emplace_back(std::move(p));
+	}
+
+	//(2) submit every compile, then every link, without checking status in between:
+	for (auto &p : pending) {
+		p.vertex_shader = gl_submit_shader(GL_VERTEX_SHADER, sources[p.index].vertex);
+		p.fragment_shader = gl_submit_shader(GL_FRAGMENT_SHADER, sources[p.index].fragment);
+	}
+	for (auto &p : pending) {
+		GLuint program = glCreateProgram();
+		glAttachShader(program, p.vertex_shader);
+		glAttachShader(program, p.fragment_shader);
+		//ask the driver to keep a binary around to cache:
+		if (!p.entry.empty()) {
+			extensions.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glLinkProgram(program);
+		programs[p.index] = program;
+	}
+
+	//(3) collect results -- with parallel compile, in whatever order programs finish,
+	// so that checking and caching finished programs overlaps the rest of the compiles:
+	bool failed = false;
+	size_t remaining = pending.size();
+	while (remaining > 0) {
+		size_t was_remaining = remaining;
+		for (auto &p : pending) {
+			if (p.done) continue;
+			GLuint program = programs[p.index];
+			if (extensions.parallel_compile && remaining > 1) {
+				GLint complete = GL_FALSE;
+				glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+				if (complete != GL_TRUE) continue;
+			}
+			p.done = true;
+			remaining -= 1;
+
+			GLint link_status = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+			if (link_status != GL_TRUE) {
+				failed = true;
+				for (GLuint shader : { p.vertex_shader, p.fragment_shader }) {
+					GLint compile_status = GL_FALSE;
+					glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+					if (compile_status != GL_TRUE) {
+						std::cerr << "Failed to compile shader." << std::endl;
+						print_info_log(shader, false);
+					}
+				}
+				std::cerr << "Failed to link shader program." << std::endl;
+				print_info_log(program, true);
+			} else if (!p.entry.empty()) {
+				save_cached_program(extensions, p.entry, p.key, program);
+			}
+
+			//shaders are reference counted so this makes sure they are freed after program is deleted:
+			glDeleteShader(p.vertex_shader);
+			glDeleteShader(p.fragment_shader);
+		}
+		//nothing finished this pass? give the driver's compiler threads a moment:
+		if (remaining == was_remaining) std::this_thread::yield();
+	}
+
+	if (failed) {
+		for (GLuint program : programs) {
+			if (program != 0) glDeleteProgram(program);
+		}
 		throw std::runtime_error("failed to link program");
 	}
 
-	return program;
+	//point every program's per-frame uniform block at the shared buffer:
+	// (GLSL 3.30 can't say layout(binding=...), so it's done here, after linking or loading)
+	for (GLuint program : programs) {
+		GLuint block = glGetUniformBlockIndex(program, FrameUniformsBlock);
+		if (block != GL_INVALID_INDEX) glUniformBlockBinding(program, block, FrameUniformsBinding);
+	}
+
+	auto after = std::chrono::high_resolution_clock::now();
+	gl_program_cache_stats.seconds += std::chrono::duration< float >(after - before).count();
+	return programs;
+}
+
+GLuint gl_compile_program(
+	std::string const &vertex_shader_source,
+	std::string const &fragment_shader_source
+	) {
+	return gl_compile_programs({ GLProgramSources{ vertex_shader_source, fragment_shader_source } })[0];
 }
@@ -3,9 +3,44 @@
 #include "GL.hpp"
 
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 //compiles+links an OpenGL shader program from source.
 // throws on compilation error.
+//
+//When the driver supports ARB_get_program_binary, linked programs are also kept in an on-disk
+// cache (keyed by a hash of the sources and the GL vendor/renderer/version strings) and later
+// calls reload the binary instead of compiling. If the driver rejects a cached binary, the
+// program is compiled from source as usual (and the cache entry replaced).
+//
+//Programs that declare the per-frame 'Frame' uniform block read it from FrameUniformsBinding
+// (see frame_uniforms.hpp).
 GLuint gl_compile_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source);
+
+//Sources for one program in a batch:
+struct GLProgramSources {
+	std::string vertex;
+	std::string fragment;
+};
+
+//compiles+links a batch of programs, returning them in the same order as 'sources'.
+//All compiles and links are submitted before any status is checked, so the driver can work on
+// them concurrently (using its own threads, if KHR_parallel_shader_compile is supported).
+// throws (after deleting every program in the batch) if any program fails to compile or link.
+//Prefer one call with every program to several calls to gl_compile_program.
+std::vector< GLuint > gl_compile_programs(std::vector< GLProgramSources > const &sources);
+
+//Where program binaries are cached (created on first write); set to "" to turn caching off:
+extern std::string gl_program_cache_directory;
+
+//What the cache has done so far (handy for reporting startup time):
+struct GLProgramCacheStats {
+	uint32_t hits = 0; //programs loaded from a cached binary
+	uint32_t misses = 0; //programs compiled from source (because there was no entry, or no cache support)
+	uint32_t rejected = 0; //cached binaries the driver refused (also counted in 'misses')
+	float seconds = 0.0f; //total time spent in gl_compile_program
+};
+extern GLProgramCacheStats gl_program_cache_stats;
@@ -1,34 +1,51 @@
 #include "load_save_png.hpp"
 
+#include "ThreadPool.hpp"
+#include "MappedFile.hpp"
+
 #include <png.h>
+#include <zlib.h>
 
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define PNG_PALETTE_SSE2
+#endif
+
 #define LOG_ERROR( X ) std::cerr << X << std::endl
 
 using std::vector;
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin);
-void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin);
+void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin, PNGSaveOptions const &options);
 
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
 	assert(size);
 
-	std::ifstream file(filename.c_str(), std::ios::binary);
-	if (!file) {
+	MappedFile file;
+	try {
+		file = MappedFile(filename);
+	} catch (std::exception &) {
 		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
 	}
-	if (!load_png(file, &size->x, &size->y, data, origin)) {
+	try {
+		load_png(file.data(), file.size(), size, data, origin);
+	} catch (std::exception &) {
 		throw std::runtime_error("Failed to read PNG image from '" + filename + "'.");
 	}
 }
 
-void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin) {
+void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin, PNGSaveOptions const &options) {
 	std::ofstream file(filename.c_str(), std::ios::binary);
-	save_png(file, size.x, size.y, data, origin);
+	save_png(file, size.x, size.y, data, origin, options);
 }
 
 
@@ -40,136 +57,669 @@ static void user_read_data(png_structp png_ptr, png_bytep data, png_size_t lengt
 	}
 }
 
-static void user_write_data(png_structp png_ptr, png_bytep data, png_size_t length) {
-	std::ostream *to = reinterpret_cast< std::ostream * >(png_get_io_ptr(png_ptr));
-	assert(to);
-	if (!to->write(reinterpret_cast< char * >(data), length)) {
-		png_error(png_ptr, "Error writing.");
+//reads straight out of a span of memory:
+struct PNGMemoryReader {
+	uint8_t const *at = nullptr;
+	size_t remaining = 0;
+};
+
+static void memory_read_data(png_structp png_ptr, png_bytep data, png_size_t length) {
+	PNGMemoryReader *from = reinterpret_cast< PNGMemoryReader * >(png_get_io_ptr(png_ptr));
+	assert(from);
+	if (length > from->remaining) {
+		png_error(png_ptr, "Error reading (past end of buffer).");
 	}
+	std::memcpy(data, from->at, length);
+	from->at += length;
+	from->remaining -= length;
 }
 
-static void user_flush_data(png_structp png_ptr) {
-	std::ostream *to = reinterpret_cast< std::ostream * >(png_get_io_ptr(png_ptr));
-	assert(to);
-	if (!to->flush()) {
-		png_error(png_ptr, "Error flushing.");
-	}
+//Set up libpng to turn whatever is in the file into 8-bit RGBA, and update 'info' to match:
+static void png_set_rgba_transforms(png_structp png, png_infop info) {
+	if (png_get_color_type(png, info) == PNG_COLOR_TYPE_PALETTE)
+		png_set_palette_to_rgb(png);
+	if (png_get_valid(png, info, PNG_INFO_tRNS))
+		png_set_tRNS_to_alpha(png);
+	if (png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY || png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY_ALPHA)
+		png_set_gray_to_rgb(png);
+	if (!(png_get_color_type(png, info) & PNG_COLOR_MASK_ALPHA))
+		png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+	if (png_get_bit_depth(png, info) < 8)
+		png_set_packing(png);
+	if (png_get_bit_depth(png,info) == 16)
+		png_set_strip_16(png);
+	//Ok, should be 32-bit RGBA now.
+
+	//(png_read_image needs this to assemble interlaced images):
+	png_set_interlace_handling(png);
+
+	png_read_update_info(png, info);
+	//Make sure it's the format we think it is...
+	assert(png_get_rowbytes(png, info) == png_get_image_width(png, info) * sizeof(uint32_t));
 }
 
+//Shared decoder: reads through 'read_fn', asks 'pixels_for' for w*h pixels of storage once
+// the size is known, and fills them with RGBA data. Returns false (and logs) on error.
+static bool load_png(void *io, png_rw_ptr read_fn, std::function< glm::u8vec4 *(glm::uvec2 const &) > const &pixels_for, glm::uvec2 *size, OriginLocation origin) {
+	assert(size);
+	*size = glm::uvec2(0);
+
+	//row table is reused from call to call (per thread) to avoid allocating one for every image:
+	static thread_local std::vector< png_bytep > row_pointers;
 
-bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin) {
-	assert(data);
-	uint32_t local_width, local_height;
-	if (width == nullptr) width = &local_width;
-	if (height == nullptr) height = &local_height;
-	*width = *height = 0;
-	data->clear();
 	//..... load file ......
 	//Load a png file, as per the libpng docs:
 	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, (png_error_ptr)NULL, (png_error_ptr)NULL);
 
-	png_set_read_fn(png, &from, user_read_data);
-
 	if (!png) {
 		LOG_ERROR("  cannot alloc read struct.");
 		return false;
 	}
+
+	png_set_read_fn(png, io, read_fn);
+
 	png_infop info = png_create_info_struct(png);
 	if (!info) {
 		LOG_ERROR("  cannot alloc info struct.");
 		png_destroy_read_struct(&png, (png_infopp)NULL, (png_infopp)NULL);
 		return false;
 	}
-	png_bytep *row_pointers = NULL;
 	if (setjmp(png_jmpbuf(png))) {
 		LOG_ERROR("  png interal error.");
 		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
-		if (row_pointers != NULL) delete[] row_pointers;
-		data->clear();
 		return false;
 	}
 	//not needed with custom read/write functions: png_init_io(png, NULL);
 	png_read_info(png, info);
 	unsigned int w = png_get_image_width(png, info);
 	unsigned int h = png_get_image_height(png, info);
-	if (png_get_color_type(png, info) == PNG_COLOR_TYPE_PALETTE)
-		png_set_palette_to_rgb(png);
-	if (png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY || png_get_color_type(png, info) == PNG_COLOR_TYPE_GRAY_ALPHA)
-		png_set_gray_to_rgb(png);
-	if (!(png_get_color_type(png, info) & PNG_COLOR_MASK_ALPHA))
-		png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
-	if (png_get_bit_depth(png, info) < 8)
-		png_set_packing(png);
-	if (png_get_bit_depth(png,info) == 16)
-		png_set_strip_16(png);
-	//Ok, should be 32-bit RGBA now.
+	png_set_rgba_transforms(png, info);
 
-	png_read_update_info(png, info);
-	size_t rowbytes = png_get_rowbytes(png, info);
-	//Make sure it's the format we think it is...
-	assert(rowbytes == w*sizeof(uint32_t));
+	glm::u8vec4 *pixels = pixels_for(glm::uvec2(w, h));
+	if (pixels == nullptr) {
+		png_destroy_read_struct(&png, &info, NULL);
+		return false;
+	}
 
-	data->resize(w*h);
-	row_pointers = new png_bytep[h];
+	row_pointers.resize(h);
 	for (unsigned int r = 0; r < h; ++r) {
 		if (origin == LowerLeftOrigin) {
-			row_pointers[h-1-r] = (png_bytep)(&(*data)[r*w]);
+			row_pointers[h-1-r] = (png_bytep)(&pixels[size_t(r)*w]);
 		} else {
-			row_pointers[r] = (png_bytep)(&(*data)[r*w]);
+			row_pointers[r] = (png_bytep)(&pixels[size_t(r)*w]);
 		}
 	}
-	png_read_image(png, row_pointers);
+	png_read_image(png, row_pointers.data());
 	png_destroy_read_struct(&png, &info, NULL);
-	delete[] row_pointers;
 
-	*width = w;
-	*height = h;
+	*size = glm::uvec2(w, h);
 	return true;
 }
 
+bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin) {
+	assert(data);
+	glm::uvec2 size;
+	bool ret = load_png(&from, user_read_data, [data](glm::uvec2 const &size) {
+		data->resize(size_t(size.x) * size.y);
+		return data->data();
+	}, &size, origin);
+	if (!ret) data->clear();
+	if (width) *width = size.x;
+	if (height) *height = size.y;
+	return ret;
+}
 
-void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin) {
-//After the libpng example.c
-	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+glm::uvec2 png_size(uint8_t const *bytes, size_t length) {
+	static uint8_t const signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	//signature, then IHDR: length (4), type (4), width (4), height (4), ...
+	if (length < 8 + 4 + 4 + 8 || std::memcmp(bytes, signature, 8) != 0 || std::memcmp(bytes + 12, "IHDR", 4) != 0) {
+		throw std::runtime_error("Data is not a PNG image.");
+	}
+	auto get_u32 = [](uint8_t const *at) {
+		return (uint32_t(at[0]) << 24) | (uint32_t(at[1]) << 16) | (uint32_t(at[2]) << 8) | uint32_t(at[3]);
+	};
+	return glm::uvec2(get_u32(bytes + 16), get_u32(bytes + 20));
+}
 
-	png_set_write_fn(png_ptr, &to, user_write_data, user_flush_data);
+void load_png(uint8_t const *bytes, size_t length, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
+	assert(data);
+	PNGMemoryReader reader;
+	reader.at = bytes;
+	reader.remaining = length;
+	bool ret = load_png(&reader, memory_read_data, [data](glm::uvec2 const &size) {
+		data->resize(size_t(size.x) * size.y);
+		return data->data();
+	}, size, origin);
+	if (!ret) {
+		data->clear();
+		throw std::runtime_error("Failed to read PNG image from memory.");
+	}
+}
 
-	if (png_ptr == NULL) {
-		LOG_ERROR("Can't create write struct.");
-		return;
+void load_png(uint8_t const *bytes, size_t length, glm::uvec2 *size, glm::u8vec4 *pixels, size_t pixel_capacity, OriginLocation origin) {
+	assert(pixels || pixel_capacity == 0);
+	PNGMemoryReader reader;
+	reader.at = bytes;
+	reader.remaining = length;
+	bool ret = load_png(&reader, memory_read_data, [pixels,pixel_capacity](glm::uvec2 const &size) -> glm::u8vec4 * {
+		if (size_t(size.x) * size.y > pixel_capacity) {
+			LOG_ERROR("  PNG is " << size.x << "x" << size.y << ", but only " << pixel_capacity << " pixels were provided.");
+			return nullptr;
+		}
+		return pixels;
+	}, size, origin);
+	if (!ret) {
+		throw std::runtime_error("Failed to read PNG image from memory.");
 	}
+}
 
-	png_infop info_ptr = png_create_info_struct(png_ptr);
-	if (info_ptr == NULL) {
-		png_destroy_write_struct(&png_ptr, NULL);
-		LOG_ERROR("Can't craete info pointer");
-		return;
+void load_png_bands(std::string filename, uint32_t band_rows, OriginLocation origin, PNGBandCallback const &on_band) {
+	MappedFile file;
+	try {
+		file = MappedFile(filename);
+	} catch (std::exception &) {
+		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
 	}
+	load_png_bands(file.data(), file.size(), band_rows, origin, on_band);
+}
 
-	if (setjmp(png_jmpbuf(png_ptr))) {
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		LOG_ERROR("Error writing png.");
+void load_png_bands(uint8_t const *bytes, size_t length, uint32_t band_rows, OriginLocation origin, PNGBandCallback const &on_band) {
+	if (band_rows == 0) {
+		throw std::runtime_error("load_png_bands needs at least one row per band.");
+	}
+
+	PNGMemoryReader reader;
+	reader.at = bytes;
+	reader.remaining = length;
+
+	std::vector< glm::u8vec4 > band;
+
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, (png_error_ptr)NULL, (png_error_ptr)NULL);
+	if (!png) {
+		throw std::runtime_error("Failed to read PNG image (cannot alloc read struct).");
+	}
+	png_set_read_fn(png, &reader, memory_read_data);
+	png_infop info = png_create_info_struct(png);
+	if (!info) {
+		png_destroy_read_struct(&png, (png_infopp)NULL, (png_infopp)NULL);
+		throw std::runtime_error("Failed to read PNG image (cannot alloc info struct).");
+	}
+	if (setjmp(png_jmpbuf(png))) {
+		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+		throw std::runtime_error("Failed to read PNG image (png internal error).");
+	}
+
+	png_read_info(png, info);
+	glm::uvec2 size(png_get_image_width(png, info), png_get_image_height(png, info));
+	bool interlaced = (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE);
+	png_set_rgba_transforms(png, info);
+
+	if (interlaced) {
+		//interlaced images only have complete rows at the very end, so can't really be streamed;
+		// decode them whole and hand out the result in bands, so callers don't need to care:
+		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+		std::vector< glm::u8vec4 > whole;
+		load_png(bytes, length, &size, &whole, origin);
+		for (uint32_t y = 0; y < size.y; y += band_rows) {
+			uint32_t rows = std::min(band_rows, size.y - y);
+			on_band(size, y, rows, &whole[size_t(y) * size.x]);
+		}
 		return;
 	}
 
-	//Not needed with custom read/write functions: png_init_io(png_ptr, fp);
-	png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	band.resize(size_t(std::min(band_rows, size.y)) * size.x);
+	for (uint32_t file_row = 0; file_row < size.y; file_row += band_rows) {
+		uint32_t rows = std::min(band_rows, size.y - file_row);
+		//rows come out of the file top-to-bottom; for LowerLeftOrigin the band is stored bottom-to-top:
+		for (uint32_t r = 0; r < rows; ++r) {
+			uint32_t slot = (origin == LowerLeftOrigin ? rows - 1 - r : r);
+			png_read_row(png, (png_bytep)&band[size_t(slot) * size.x], NULL);
+		}
+		uint32_t y = (origin == LowerLeftOrigin ? size.y - file_row - rows : file_row);
+		try {
+			on_band(size, y, rows, band.data());
+		} catch (...) {
+			png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+			throw;
+		}
+	}
+	png_read_end(png, NULL);
+	png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+}
 
-	png_write_info(png_ptr, info_ptr);
-	//png_set_swap_alpha(png_ptr) // might need?
-	vector< png_bytep > row_pointers(height);
-	for (unsigned int i = 0; i < height; ++i) {
-		if (origin == UpperLeftOrigin) {
-			row_pointers[i] = (png_bytep)&(data[i * width]);
-		} else {
-			row_pointers[i] = (png_bytep)&(data[(height - 1 - i) * width]);
+std::vector< std::future< PNGImage > > load_png_batch(std::vector< std::string > const &filenames, OriginLocation origin) {
+	std::vector< std::future< PNGImage > > ret;
+	ret.reserve(filenames.size());
+	for (auto const &filename : filenames) {
+		ret.emplace_back(ThreadPool::shared().enqueue([filename,origin]() {
+			PNGImage image;
+			load_png(filename, &image.size, &image.data, origin);
+			return image;
+		}));
+	}
+	return ret;
+}
+
+void load_png_batch(std::vector< std::string > const &filenames, OriginLocation origin,
+	std::function< void(size_t index, PNGImage &&image, std::exception_ptr error) > const &on_done) {
+	for (size_t i = 0; i < filenames.size(); ++i) {
+		std::string filename = filenames[i];
+		ThreadPool::shared().push([i,filename,origin,on_done]() {
+			PNGImage image;
+			std::exception_ptr error;
+			try {
+				load_png(filename, &image.size, &image.data, origin);
+			} catch (...) {
+				error = std::current_exception();
+				image = PNGImage();
+			}
+			on_done(i, std::move(image), error);
+		});
+	}
+}
+
+
+//------------------ parallel encoder ------------------
+//Rather than going through libpng, save_png builds the file itself so that filtering and
+// compression can be split across cores (the same trick pigz uses):
+// - rows are grouped into chunks;
+// - each chunk is filtered and raw-deflated independently, primed with the (filtered) 32k
+//   that precede it as a dictionary, and ended with a sync flush so it is byte-aligned;
+// - the pieces are concatenated into one zlib stream (adler32s combined) in a single IDAT.
+
+static void png_put_u32(std::vector< uint8_t > *out, uint32_t val) {
+	out->emplace_back(uint8_t(val >> 24));
+	out->emplace_back(uint8_t(val >> 16));
+	out->emplace_back(uint8_t(val >> 8));
+	out->emplace_back(uint8_t(val));
+}
+
+//append a chunk whose payload is given as a list of pieces:
+static void png_put_chunk(std::vector< uint8_t > *out, char const type[4], std::vector< std::vector< uint8_t > const * > const &pieces) {
+	size_t length = 0;
+	for (auto piece : pieces) length += piece->size();
+	assert(length < 0x80000000ULL && "PNG chunks are limited to 2^31-1 bytes");
+	png_put_u32(out, uint32_t(length));
+	out->insert(out->end(), type, type + 4);
+	uLong crc = crc32(0L, reinterpret_cast< Bytef const * >(type), 4);
+	for (auto piece : pieces) {
+		if (piece->empty()) continue; //(crc32 with a null buffer would reset the crc)
+		out->insert(out->end(), piece->begin(), piece->end());
+		crc = crc32(crc, piece->data(), uInt(piece->size()));
+	}
+	png_put_u32(out, uint32_t(crc));
+}
+
+static void png_put_chunk(std::vector< uint8_t > *out, char const type[4], std::vector< uint8_t > const &payload) {
+	png_put_chunk(out, type, std::vector< std::vector< uint8_t > const * >{ &payload });
+}
+
+static inline uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+	int p = int(a) + int(b) - int(c);
+	int pa = std::abs(p - int(a));
+	int pb = std::abs(p - int(b));
+	int pc = std::abs(p - int(c));
+	if (pa <= pb && pa <= pc) return a;
+	else if (pb <= pc) return b;
+	else return c;
+}
+
+//write 'row' filtered with 'filter' (which must not be adaptive) to 'out':
+// ('prev' is the row above, which is all zeros for the first row)
+static void png_filter_row(PNGFilter filter, uint8_t const *row, uint8_t const *prev, size_t row_bytes, size_t bpp, uint8_t *out) {
+	//bytes to the left of the row are treated as zero:
+	auto left = [&](size_t i) -> uint8_t { return (i >= bpp ? row[i - bpp] : 0); };
+	auto up_left = [&](size_t i) -> uint8_t { return (i >= bpp ? prev[i - bpp] : 0); };
+	switch (filter) {
+		case PNGFilterNone:
+			std::memcpy(out, row, row_bytes);
+			break;
+		case PNGFilterSub:
+			for (size_t i = 0; i < row_bytes; ++i) out[i] = uint8_t(row[i] - left(i));
+			break;
+		case PNGFilterUp:
+			for (size_t i = 0; i < row_bytes; ++i) out[i] = uint8_t(row[i] - prev[i]);
+			break;
+		case PNGFilterAverage:
+			for (size_t i = 0; i < row_bytes; ++i) out[i] = uint8_t(row[i] - ((uint32_t(left(i)) + uint32_t(prev[i])) >> 1));
+			break;
+		case PNGFilterPaeth:
+			for (size_t i = 0; i < row_bytes; ++i) out[i] = uint8_t(row[i] - paeth(left(i), prev[i], up_left(i)));
+			break;
+		case PNGFilterAdaptive:
+			assert(0 && "adaptive filtering is resolved by png_filter_rows");
+			break;
+	}
+}
+
+//Description of the (already converted-to-PNG-layout) rows handed to the encoder:
+struct PNGRows {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint8_t color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+	uint8_t bit_depth = 8;
+	size_t row_bytes = 0;
+	size_t bpp = 4; //bytes per complete pixel (rounded up to 1), used for filtering
+	std::function< uint8_t const *(uint32_t y) > row; //y == 0 is the top row of the file
+};
+
+//append filtered rows [begin,end) -- filter type byte followed by filtered data -- to 'out':
+static void png_filter_rows(PNGRows const &rows, PNGFilter filter, uint32_t begin, uint32_t end, std::vector< uint8_t > *out) {
+	size_t stride = rows.row_bytes + 1;
+	size_t base = out->size();
+	out->resize(base + size_t(end - begin) * stride);
+	std::vector< uint8_t > trial;
+	if (filter == PNGFilterAdaptive) trial.resize(rows.row_bytes);
+	std::vector< uint8_t > zeros;
+	if (begin == 0) zeros.resize(rows.row_bytes, 0);
+	for (uint32_t y = begin; y < end; ++y) {
+		uint8_t *dst = out->data() + base + size_t(y - begin) * stride;
+		uint8_t const *row = rows.row(y);
+		uint8_t const *prev = (y > 0 ? rows.row(y - 1) : zeros.data());
+		if (filter != PNGFilterAdaptive) {
+			dst[0] = uint8_t(filter);
+			png_filter_row(filter, row, prev, rows.row_bytes, rows.bpp, dst + 1);
+			continue;
+		}
+		uint64_t best_cost = ~uint64_t(0);
+		for (uint8_t f = PNGFilterNone; f <= PNGFilterPaeth; ++f) {
+			png_filter_row(PNGFilter(f), row, prev, rows.row_bytes, rows.bpp, trial.data());
+			uint64_t cost = 0;
+			for (auto b : trial) cost += uint64_t(std::abs(int(int8_t(b))));
+			if (cost < best_cost) {
+				best_cost = cost;
+				dst[0] = f;
+				std::memcpy(dst + 1, trial.data(), rows.row_bytes);
+			}
+		}
+	}
+}
+
+//Compressed piece of the IDAT stream:
+struct PNGPiece {
+	std::vector< uint8_t > data;
+	uLong adler = 1;
+	size_t raw_length = 0;
+	std::string error;
+};
+
+static bool png_encode(PNGRows const &rows, std::vector< std::vector< uint8_t > > const &extra_chunks, PNGSaveOptions const &options, std::vector< uint8_t > *out) {
+	assert(out);
+	out->clear();
+
+	int level = std::max(0, std::min(9, options.compression_level));
+	PNGFilter filter = options.filter;
+	//PNG spec recommends unfiltered rows for indexed and sub-byte images:
+	if (rows.color_type == PNG_COLOR_TYPE_PALETTE || rows.bit_depth < 8) filter = PNGFilterNone;
+
+	//----- chunking -----
+	size_t stride = rows.row_bytes + 1;
+	uint32_t rows_per_chunk = options.rows_per_chunk;
+	if (rows_per_chunk == 0) {
+		//~256k of raw data per job keeps cores busy without hurting ratio much:
+		rows_per_chunk = uint32_t(std::max< size_t >(1, (256 * 1024) / stride));
+	}
+	uint32_t chunks = (rows.height + rows_per_chunk - 1) / rows_per_chunk;
+	if (chunks == 0) chunks = 1;
+
+	//----- filter + deflate each chunk -----
+	std::vector< PNGPiece > pieces(chunks);
+	ThreadPool::shared().parallel_for(chunks, [&](size_t c) {
+		PNGPiece &piece = pieces[c];
+		uint32_t begin = uint32_t(std::min< size_t >(rows.height, c * size_t(rows_per_chunk)));
+		uint32_t end = uint32_t(std::min< size_t >(rows.height, begin + size_t(rows_per_chunk)));
+		bool last = (c + 1 == chunks);
+
+		//the filtered bytes just before this chunk serve as its dictionary, so matches can still reach back:
+		std::vector< uint8_t > dictionary;
+		if (begin > 0 && level > 0) {
+			uint32_t dict_rows = uint32_t(std::min< size_t >(begin, (32768 + stride - 1) / stride));
+			png_filter_rows(rows, filter, begin - dict_rows, begin, &dictionary);
+			if (dictionary.size() > 32768) dictionary.erase(dictionary.begin(), dictionary.end() - 32768);
+		}
+
+		std::vector< uint8_t > raw;
+		raw.reserve(size_t(end - begin) * stride);
+		png_filter_rows(rows, filter, begin, end, &raw);
+		piece.raw_length = raw.size();
+		piece.adler = adler32(adler32(0L, Z_NULL, 0), raw.data(), uInt(raw.size()));
+
+		z_stream strm;
+		std::memset(&strm, 0, sizeof(strm));
+		if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			piece.error = "deflateInit2 failed";
+			return;
+		}
+		if (!dictionary.empty()) {
+			deflateSetDictionary(&strm, dictionary.data(), uInt(dictionary.size()));
+		}
+		piece.data.resize(deflateBound(&strm, uLong(raw.size())) + 16);
+		strm.next_in = raw.data();
+		strm.avail_in = uInt(raw.size());
+		strm.next_out = piece.data.data();
+		strm.avail_out = uInt(piece.data.size());
+		int ret = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+		if (ret == Z_STREAM_ERROR || strm.avail_in != 0 || (last && ret != Z_STREAM_END)) {
+			piece.error = "deflate failed";
+		}
+		piece.data.resize(piece.data.size() - strm.avail_out);
+		deflateEnd(&strm);
+	});
+
+	for (auto const &piece : pieces) {
+		if (!piece.error.empty()) {
+			LOG_ERROR("PNG encode: " << piece.error);
+			return false;
+		}
+	}
+
+	//----- stitch into a zlib stream -----
+	//header: 32k window, deflate, FLEVEL from compression level, FCHECK making it a multiple of 31:
+	uint8_t flevel = (level < 2 ? 0 : (level < 6 ? 1 : (level == 6 ? 2 : 3)));
+	uint16_t header = uint16_t((0x78 << 8) | (flevel << 6));
+	header = uint16_t(header + (31 - header % 31) % 31);
+	std::vector< uint8_t > zlib_header{ uint8_t(header >> 8), uint8_t(header) };
+
+	uLong adler = adler32(0L, Z_NULL, 0);
+	for (auto const &piece : pieces) {
+		adler = adler32_combine(adler, piece.adler, z_off_t(piece.raw_length));
+	}
+	std::vector< uint8_t > zlib_trailer;
+	png_put_u32(&zlib_trailer, uint32_t(adler));
+
+	std::vector< std::vector< uint8_t > const * > idat;
+	idat.emplace_back(&zlib_header);
+	for (auto const &piece : pieces) idat.emplace_back(&piece.data);
+	idat.emplace_back(&zlib_trailer);
+
+	//----- file -----
+	static uint8_t const signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	out->insert(out->end(), signature, signature + 8);
+
+	std::vector< uint8_t > ihdr;
+	png_put_u32(&ihdr, rows.width);
+	png_put_u32(&ihdr, rows.height);
+	ihdr.emplace_back(rows.bit_depth);
+	ihdr.emplace_back(rows.color_type);
+	ihdr.emplace_back(uint8_t(0)); //compression: deflate
+	ihdr.emplace_back(uint8_t(0)); //filter method: adaptive (per-row filter bytes)
+	ihdr.emplace_back(uint8_t(0)); //no interlace
+	png_put_chunk(out, "IHDR", ihdr);
+
+	//extra chunks (e.g., PLTE) come pre-built:
+	for (auto const &chunk : extra_chunks) {
+		out->insert(out->end(), chunk.begin(), chunk.end());
+	}
+
+	png_put_chunk(out, "IDAT", idat);
+	png_put_chunk(out, "IEND", std::vector< uint8_t >());
+
+	return true;
+}
+
+static inline glm::u8vec4 png_unpack_color(uint32_t c) {
+	uint8_t bytes[4];
+	std::memcpy(bytes, &c, 4);
+	return glm::u8vec4(bytes[0], bytes[1], bytes[2], bytes[3]);
+}
+
+//Small open-addressed color -> palette index table, used to find images with few colors:
+struct PNGPalette {
+	static constexpr uint32_t MaxColors = 256;
+	static constexpr uint32_t Slots = 512; //power of two, at least 2*MaxColors
+
+	uint32_t keys[Slots];
+	uint16_t values[Slots]; //index + 1; zero means empty
+	std::vector< uint32_t > colors; //in order of first appearance
+
+	PNGPalette() { std::memset(values, 0, sizeof(values)); colors.reserve(MaxColors); }
+
+	static uint32_t slot_for(uint32_t color) { return (color * 0x9E3779B1u) >> 23; }
+
+	//returns index, or -1 if the palette is full:
+	int32_t insert(uint32_t color) {
+		for (uint32_t s = slot_for(color); ; s = (s + 1) & (Slots - 1)) {
+			if (values[s] == 0) {
+				if (colors.size() == MaxColors) return -1;
+				keys[s] = color;
+				colors.emplace_back(color);
+				values[s] = uint16_t(colors.size());
+				return int32_t(colors.size() - 1);
+			}
+			if (keys[s] == color) return int32_t(values[s] - 1);
+		}
+	}
+
+	//re-number so that translucent colors come first (so the tRNS chunk can stop at the last one):
+	void translucent_first() {
+		std::vector< uint32_t > order = colors;
+		std::stable_partition(order.begin(), order.end(), [](uint32_t c){
+			return png_unpack_color(c).a != 0xff;
+		});
+		std::memset(values, 0, sizeof(values));
+		colors.clear();
+		for (uint32_t c : order) insert(c);
+	}
+
+	uint8_t find(uint32_t color) const {
+		for (uint32_t s = slot_for(color); ; s = (s + 1) & (Slots - 1)) {
+			assert(values[s] != 0 && "color must be in palette");
+			if (keys[s] == color) return uint8_t(values[s] - 1);
 		}
 	}
-	png_write_image(png_ptr, &(row_pointers[0]));
+};
 
-	png_write_end(png_ptr, info_ptr);
+//Scan the image, stopping as soon as it has too many colors. Runs of the same color are common
+// in game frames, so four pixels at a time are compared against the last color seen, and only
+// pixels that differ touch the hash table:
+static bool png_find_palette(glm::u8vec4 const *data, size_t count, PNGPalette *palette) {
+	uint32_t const *px = reinterpret_cast< uint32_t const * >(data);
+	static_assert(sizeof(glm::u8vec4) == sizeof(uint32_t), "pixels are packed");
+	if (count == 0) return true;
+	uint32_t last = px[0];
+	if (palette->insert(last) < 0) return false;
+	size_t i = 0;
+#ifdef PNG_PALETTE_SSE2
+	__m128i last4 = _mm_set1_epi32(int32_t(last));
+	for (; i + 4 <= count; i += 4) {
+		__m128i four = _mm_loadu_si128(reinterpret_cast< __m128i const * >(px + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(four, last4)) == 0xffff) continue;
+		for (size_t j = i; j < i + 4; ++j) {
+			if (px[j] == last) continue;
+			last = px[j];
+			if (palette->insert(last) < 0) return false;
+		}
+		last4 = _mm_set1_epi32(int32_t(last));
+	}
+#endif
+	for (; i < count; ++i) {
+		if (px[i] == last) continue;
+		last = px[i];
+		if (palette->insert(last) < 0) return false;
+	}
+	return true;
+}
 
-	png_destroy_write_struct(&png_ptr, &info_ptr);
+void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin, PNGSaveOptions const &options) {
+	//PNG doesn't allow empty images (and palette detection below reads the first pixel):
+	if (width == 0 || height == 0) {
+		LOG_ERROR("Error writing png: image is " << width << "x" << height << ".");
+		return;
+	}
+
+	PNGRows rows;
+	rows.width = width;
+	rows.height = height;
+	auto source_row = [=](uint32_t y) {
+		return data + size_t(origin == UpperLeftOrigin ? y : height - 1 - y) * width;
+	};
+
+	std::vector< std::vector< uint8_t > > extra_chunks;
+	std::vector< uint8_t > indices; //packed palette indices, in file row order
 
-	return;
+	PNGPalette palette;
+	if (options.try_palette && png_find_palette(data, size_t(width) * height, &palette)) {
+		palette.translucent_first();
+
+		std::vector< uint8_t > plte, trns;
+		for (uint32_t c : palette.colors) {
+			glm::u8vec4 color = png_unpack_color(c);
+			plte.insert(plte.end(), { color.r, color.g, color.b });
+			if (color.a != 0xff) trns.emplace_back(color.a);
+		}
+		extra_chunks.emplace_back();
+		png_put_chunk(&extra_chunks.back(), "PLTE", plte);
+		if (!trns.empty()) {
+			extra_chunks.emplace_back();
+			png_put_chunk(&extra_chunks.back(), "tRNS", trns);
+		}
+
+		uint8_t bits = (palette.colors.size() <= 2 ? 1 : (palette.colors.size() <= 4 ? 2 : (palette.colors.size() <= 16 ? 4 : 8)));
+		rows.color_type = PNG_COLOR_TYPE_PALETTE;
+		rows.bit_depth = bits;
+		rows.row_bytes = (size_t(width) * bits + 7) / 8;
+		rows.bpp = 1;
+
+		//convert to (packed, leftmost pixel in the high bits) indices:
+		indices.assign(rows.row_bytes * height, 0);
+		ThreadPool::shared().parallel_for((height + 63) / 64, [&](size_t band) {
+			uint32_t begin = uint32_t(band * 64);
+			uint32_t end = std::min(height, begin + 64);
+			for (uint32_t y = begin; y < end; ++y) {
+				uint32_t const *src = reinterpret_cast< uint32_t const * >(source_row(y));
+				uint8_t *dst = &indices[y * rows.row_bytes];
+				uint32_t last = src[0];
+				uint8_t last_index = palette.find(last);
+				for (uint32_t x = 0; x < width; ++x) {
+					if (src[x] != last) {
+						last = src[x];
+						last_index = palette.find(last);
+					}
+					uint32_t bit = x * bits;
+					dst[bit / 8] |= uint8_t(last_index << (8 - bits - (bit % 8)));
+				}
+			}
+		});
+		rows.row = [&](uint32_t y) -> uint8_t const * {
+			return &indices[y * rows.row_bytes];
+		};
+	} else {
+		rows.color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+		rows.bit_depth = 8;
+		rows.row_bytes = size_t(width) * 4;
+		rows.bpp = 4;
+		rows.row = [&](uint32_t y) -> uint8_t const * {
+			return reinterpret_cast< uint8_t const * >(source_row(y));
+		};
+	}
+
+	//the whole file is assembled in memory so it reaches the stream in one large write:
+	std::vector< uint8_t > buffer;
+	if (!png_encode(rows, extra_chunks, options, &buffer)) {
+		LOG_ERROR("Error writing png.");
+		return;
+	}
+	if (!to.write(reinterpret_cast< char const * >(buffer.data()), buffer.size()) || !to.flush()) {
+		LOG_ERROR("Error writing png.");
+	}
 }
@@ -2,6 +2,9 @@
 
 #include <glm/glm.hpp>
 
+#include <exception>
+#include <functional>
+#include <future>
 #include <string>
 #include <vector>
 #include <stdint.h>
@@ -15,6 +18,57 @@ enum OriginLocation {
 	UpperLeftOrigin,
 };
 
+//Per-row filters used by save_png (see section 9 of the PNG spec):
+enum PNGFilter {
+	PNGFilterNone,
+	PNGFilterSub,
+	PNGFilterUp,
+	PNGFilterAverage,
+	PNGFilterPaeth,
+	PNGFilterAdaptive, //try all of the above, keep the one with smallest sum-of-absolute-values (what libpng does)
+};
+
+//Knobs for save_png:
+struct PNGSaveOptions {
+	int compression_level = 6; //zlib level: 0 (store) through 9 (smallest); 1-3 are much faster
+	PNGFilter filter = PNGFilterAdaptive;
+	//rows are split into chunks that are filtered+deflated in parallel; 0 picks a size automatically:
+	uint32_t rows_per_chunk = 0;
+	//if the image has 256 or fewer distinct colors, write it as an (much smaller) indexed-color PNG:
+	// (falls back to RGBA automatically when there are more)
+	bool try_palette = false;
+};
+
 //NOTE: load_png will throw on error
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
-void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin);
+
+//Decode a PNG that is already in memory (e.g., a MappedFile or a packfile entry):
+void load_png(uint8_t const *bytes, size_t length, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
+//...directly into caller-provided storage of at least size.x*size.y pixels (throws if it is too small):
+void load_png(uint8_t const *bytes, size_t length, glm::uvec2 *size, glm::u8vec4 *pixels, size_t pixel_capacity, OriginLocation origin);
+//...and the size of such a PNG, read from its header without decoding (throws if not a PNG):
+glm::uvec2 png_size(uint8_t const *bytes, size_t length);
+
+//Decode a band of rows at a time, so peak memory is a band rather than the whole image
+// (e.g., to upload to a texture with glTexSubImage2D as decoding proceeds):
+//'on_band' is called with 'rows' rows starting at row 'y' -- counted from the bottom for LowerLeftOrigin
+// and from the top for UpperLeftOrigin, and stored in that same order -- so the pixels can be handed
+// straight to glTexSubImage2D(..., 0, y, size.x, rows, ...). Bands arrive in file (top-down) order.
+//NOTE: interlaced images are decoded whole internally (they can't be streamed), then handed out in bands.
+typedef std::function< void(glm::uvec2 const &size, uint32_t y, uint32_t rows, glm::u8vec4 const *pixels) > PNGBandCallback;
+void load_png_bands(std::string filename, uint32_t band_rows, OriginLocation origin, PNGBandCallback const &on_band);
+void load_png_bands(uint8_t const *bytes, size_t length, uint32_t band_rows, OriginLocation origin, PNGBandCallback const &on_band);
+
+//Decode many files concurrently (on ThreadPool::shared()):
+struct PNGImage {
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< glm::u8vec4 > data;
+};
+//one future per filename, in order; get() rethrows load_png's exception if that file failed:
+std::vector< std::future< PNGImage > > load_png_batch(std::vector< std::string > const &filenames, OriginLocation origin);
+//...or have 'on_done' called as each file finishes. returns right away; on_done runs on worker threads
+// (so it must be thread-safe) and gets a non-null 'error' if that file failed:
+void load_png_batch(std::vector< std::string > const &filenames, OriginLocation origin,
+	std::function< void(size_t index, PNGImage &&image, std::exception_ptr error) > const &on_done);
+
+void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin, PNGSaveOptions const &options = PNGSaveOptions());
@@ -7,15 +7,37 @@
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
+//gl_state filters redundant state changes (and counts them):
+#include "GLStateCache.hpp"
+
+//Packfile::assets serves shaders and images:
+#include "Packfile.hpp"
+
+//TextureStreamer::shared loads textures in the background:
+#include "TextureStreamer.hpp"
+
+//for reporting shader program cache use at startup:
+#include "gl_compile_program.hpp"
+
+//for headless (offscreen) rendering:
+#include "OffscreenTarget.hpp"
+
+//for dynamic resolution:
+#include "ResolutionScaler.hpp"
+
 //for screenshots:
 #include "load_save_png.hpp"
+#include "pixel_kernels.hpp"
 
 //Includes for libSDL:
 #include <SDL.h>
 
 //...and for c++ standard library functions:
 #include <chrono>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
@@ -26,9 +48,86 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	//--headless WxH draws into an offscreen framebuffer instead of a window, for a fixed number of
+	// frames (with fixed time steps), optionally saving each one -- for benchmarks, golden-image
+	// tests, and frame export on machines without a display:
+	struct {
+		bool enabled = false;
+		glm::uvec2 size = glm::uvec2(0);
+		uint32_t frames = 1;
+		std::string export_prefix; //if set, frame i is saved as '<prefix>NNNN.png'
+	} headless;
+	//--frame-budget MS turns on dynamic resolution (F5 toggles it) and sets the frame time it aims for:
+	float frame_budget = 6.9e-3f;
+	bool dynamic_resolution = false;
+	auto usage = [&]() {
+		std::cerr << "Usage:\n\t" << argv[0] << " [--headless <width>x<height> [--frames <count>] [--export <filename-prefix>]] [--frame-budget <ms>]" << std::endl;
+	};
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool takes_value = (arg == "--headless" || arg == "--frames" || arg == "--export" || arg == "--frame-budget");
+		if (takes_value && i + 1 >= argc) {
+			std::cerr << "Expecting a value after " << arg << "." << std::endl;
+			usage();
+			return 1;
+		}
+		if (arg == "--headless") {
+			std::istringstream str(argv[++i]);
+			char x = '\0';
+			if (!(str >> headless.size.x >> x >> headless.size.y) || x != 'x' || headless.size.x == 0 || headless.size.y == 0) {
+				std::cerr << "Expecting a size like '1280x720' after --headless, not '" << argv[i] << "'." << std::endl;
+				return 1;
+			}
+			headless.enabled = true;
+		} else if (arg == "--frames") {
+			std::string value = argv[++i];
+			unsigned long frames = 0;
+			size_t used = 0;
+			if (!value.empty() && value.find_first_not_of("0123456789") == std::string::npos) {
+				try {
+					frames = std::stoul(value, &used);
+				} catch (std::exception &) {
+					used = 0; //(out of range)
+				}
+			}
+			if (used != value.size() || frames == 0 || frames > 0xffffffffUL) {
+				std::cerr << "Expecting a positive frame count after --frames, not '" << value << "'." << std::endl;
+				usage();
+				return 1;
+			}
+			headless.frames = uint32_t(frames);
+		} else if (arg == "--export") {
+			headless.export_prefix = argv[++i];
+		} else if (arg == "--frame-budget") {
+			frame_budget = float(std::atof(argv[++i])) * 1e-3f;
+			if (!(frame_budget > 0.0f)) {
+				std::cerr << "Expecting a time in milliseconds after --frame-budget, not '" << argv[i] << "'." << std::endl;
+				return 1;
+			}
+			dynamic_resolution = true;
+		} else {
+			//(launchers sometimes add their own arguments -- e.g., '-psn_...' on macOS -- so don't refuse to start)
+			std::cerr << "NOTE: ignoring unrecognized argument '" << arg << "'." << std::endl;
+		}
+	}
+	if (!headless.enabled && (headless.frames != 1 || !headless.export_prefix.empty())) {
+		std::cerr << "--frames and --export only apply with --headless." << std::endl;
+		return 1;
+	}
+
 	//------------  initialization ------------
 
+	//startup time (everything before the first frame) is reported once the mode is created:
+	auto startup_begin = std::chrono::high_resolution_clock::now();
+
 	//Initialize SDL library:
+	if (headless.enabled) {
+		//SDL's "offscreen" driver makes GL contexts (through EGL) without any display server;
+		// set SDL_VIDEODRIVER to pick a different driver (the window is hidden either way):
+		SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0 /* don't overwrite */);
+	}
 	SDL_Init(SDL_INIT_VIDEO);
 
 	//Ask for an OpenGL context version 3.3, core profile, enable debug:
@@ -50,9 +149,10 @@ int main(int argc, char **argv) {
 		"Power Foosball", //TODO: remember to set a title for your game!
 		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 		900, 640, //TODO: modify window size if you'd like
-		SDL_WINDOW_OPENGL
+		headless.enabled ? (SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN) : (SDL_WINDOW_OPENGL
 		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
 		| SDL_WINDOW_ALLOW_HIGHDPI //uncomment for full resolution on high-DPI screens
+		)
 	);
 
 	//prevent exceedingly tiny windows when resizing:
@@ -76,7 +176,8 @@ int main(int argc, char **argv) {
 	init_GL();
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
+	// (headless runs never swap, so they don't care)
+	if (!headless.enabled && SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
 		if (SDL_GL_SetSwapInterval(1) != 0) {
 			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
@@ -86,9 +187,29 @@ int main(int argc, char **argv) {
 	//Hide mouse cursor (note: showing can be useful for debugging):
 	//SDL_ShowCursor(SDL_DISABLE);
 
+	//------------ load assets --------------
+	//shaders (and other assets) are packed into 'assets.pack', next to the executable:
+	{
+		char *base_path = SDL_GetBasePath();
+		std::string pack_path = std::string(base_path ? base_path : "") + "assets.pack";
+		SDL_free(base_path);
+		Packfile::assets = std::make_shared< Packfile >(pack_path);
+	}
+	//textures are requested by modes and stream in over the following frames:
+	TextureStreamer::shared = std::make_shared< TextureStreamer >();
+
 	//------------ create game mode + make current --------------
 	Mode::set_current(std::make_shared< FoosballMode >());
 
+	{ //report startup time (a warm program cache should make this noticeably shorter):
+		float startup = std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - startup_begin).count();
+		GLProgramCacheStats const &stats = gl_program_cache_stats;
+		std::cout << "Startup took " << startup * 1000.0f << "ms; shader programs took " << stats.seconds * 1000.0f << "ms ("
+			<< stats.hits << " from cache, " << stats.misses << " compiled";
+		if (stats.rejected) std::cout << ", " << stats.rejected << " cached binaries rejected";
+		std::cout << ")." << std::endl;
+	}
+
 	//------------ main loop ------------
 
 	//this inline function will be called whenever the window is resized,
@@ -96,7 +217,18 @@ int main(int argc, char **argv) {
 	glm::uvec2 window_size; //size of window (layout pixels)
 	glm::uvec2 drawable_size; //size of drawable (physical pixels)
 	//On non-highDPI displays, window_size will always equal drawable_size.
+	//(headless runs draw into this instead of the window:)
+	std::unique_ptr< OffscreenTarget > headless_target;
+	if (headless.enabled) {
+		headless_target.reset(new OffscreenTarget);
+		headless_target->resize(headless.size);
+	}
 	auto on_resize = [&](){
+		if (headless_target) {
+			window_size = drawable_size = headless_target->size;
+			headless_target->bind(); //(also sets the viewport)
+			return;
+		}
 		int w,h;
 		SDL_GetWindowSize(window, &w, &h);
 		window_size = glm::uvec2(w, h);
@@ -106,41 +238,139 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	uint32_t frames_drawn = 0; //(for headless runs)
+	auto frames_begin = std::chrono::high_resolution_clock::now();
+
+	//Rather than spinning at the display's refresh rate no matter what, the loop sleeps in
+	// SDL_WaitEventTimeout when there's nothing new to show:
+	//  - while minimized, nothing is updated or drawn until an event arrives;
+	//  - while unfocused, frames are limited to UnfocusedFPS;
+	//  - while the mode is idle (see Mode::idle_for), the last frame is kept until an event arrives.
+	// (headless runs never wait or skip frames)
+	const float UnfocusedFPS = 10.0f;
+	const float MaxElapsed = 0.1f; //longest time step passed to update (see below)
+	struct {
+		bool minimized = false;
+		bool focused = true;
+		bool redraw = true; //has something happened (an event, a resize, a new mode) that needs a new frame?
+		bool drawn_idle = false; //was the last frame drawn with the mode idle (so it still shows the current state)?
+		Mode const *drawn_mode = nullptr; //mode that drew the last frame
+		uint32_t drawn_change_count = 0; //...and its change_count at the time
+		std::chrono::high_resolution_clock::time_point drawn_time = std::chrono::high_resolution_clock::now();
+	} power;
+	{
+		Uint32 flags = SDL_GetWindowFlags(window);
+		power.minimized = (flags & SDL_WINDOW_MINIMIZED) != 0;
+		power.focused = (flags & SDL_WINDOW_INPUT_FOCUS) != 0;
+	}
+	//is the last frame shown still what a new one would look like?
+	auto frame_up_to_date = [&]() {
+		return !headless.enabled && !power.redraw && power.drawn_idle
+			&& power.drawn_mode == Mode::current.get() && power.drawn_change_count == Mode::current->change_count
+			&& Mode::current->idle_for() > 0.0f
+			&& TextureStreamer::shared->pending() == 0;
+	};
+
+	//With dynamic resolution on, frames are drawn smaller (to stay within frame_budget) and stretched to fit:
+	std::unique_ptr< ResolutionScaler > scaler;
+	if (dynamic_resolution) scaler.reset(new ResolutionScaler(frame_budget));
+
+	//Idle modes are drawn once into this, which is then copied to the screen until something changes:
+	// (see Mode::draw_overlay)
+	std::unique_ptr< OffscreenTarget > cached_frame(new OffscreenTarget);
+	struct {
+		bool valid = false;
+		Mode const *mode = nullptr;
+		uint32_t change_count = 0;
+	} cached;
+
+	auto handle_event = [&](SDL_Event const &evt) {
+		//any event might change what's shown:
+		power.redraw = true;
+		if (evt.type == SDL_WINDOWEVENT) {
+			//handle resizing:
+			if (evt.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+				on_resize();
+			}
+			//track visibility and focus (for throttling):
+			if (evt.window.event == SDL_WINDOWEVENT_MINIMIZED || evt.window.event == SDL_WINDOWEVENT_HIDDEN) {
+				power.minimized = true;
+			} else if (evt.window.event == SDL_WINDOWEVENT_RESTORED || evt.window.event == SDL_WINDOWEVENT_SHOWN || evt.window.event == SDL_WINDOWEVENT_MAXIMIZED) {
+				power.minimized = false;
+			} else if (evt.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
+				power.focused = true;
+			} else if (evt.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+				power.focused = false;
+			}
+		}
+		//handle input:
+		if (Mode::current && Mode::current->handle_event(evt, window_size)) {
+			// mode handled it; great
+		} else if (evt.type == SDL_QUIT) {
+			Mode::set_current(nullptr);
+		} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F3) {
+			// --- report state cache counts ---
+			std::cout << "GL state calls last frame: " << gl_state.last_frame.issued << " issued, "
+				<< gl_state.last_frame.filtered << " filtered as redundant." << std::endl;
+		} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F5) {
+			// --- toggle dynamic resolution ---
+			if (scaler) scaler.reset();
+			else scaler.reset(new ResolutionScaler(frame_budget));
+			std::cout << "Dynamic resolution: " << (scaler ? "on" : "off") << std::endl;
+		} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
+			// --- screenshot key ---
+			std::string filename = "screenshot.png";
+			std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+			glReadBuffer(GL_FRONT);
+			int w,h;
+			SDL_GL_GetDrawableSize(window, &w, &h);
+			std::vector< glm::u8vec4 > data(w*h);
+			glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+			force_alpha(data.data(), data.size());
+			//frames are mostly a handful of flat colors, so an indexed PNG is usually possible:
+			PNGSaveOptions options;
+			options.try_palette = true;
+			save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin, options);
+		}
+	};
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
-		{ //(1) process any events that are pending
+		{ //(1) process any events that are pending -- first waiting for some, if there's nothing else to do
 			static SDL_Event evt;
-			while (SDL_PollEvent(&evt) == 1) {
-				//handle resizing:
-				if (evt.type == SDL_WINDOWEVENT && evt.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-					on_resize();
+			if (!headless.enabled && power.minimized) {
+				//nothing can be seen, so there's nothing to do until something happens:
+				if (SDL_WaitEvent(&evt) == 1) handle_event(evt);
+			} else if (!headless.enabled) {
+				float wait = 0.0f;
+				if (!power.focused) {
+					//limit frame rate while in the background:
+					wait = 1.0f / UnfocusedFPS - std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - power.drawn_time).count();
 				}
-				//handle input:
-				if (Mode::current && Mode::current->handle_event(evt, window_size)) {
-					// mode handled it; great
-				} else if (evt.type == SDL_QUIT) {
-					Mode::set_current(nullptr);
-					break;
-				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
-					// --- screenshot key ---
-					std::string filename = "screenshot.png";
-					std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
-					glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-					glReadBuffer(GL_FRONT);
-					int w,h;
-					SDL_GL_GetDrawableSize(window, &w, &h);
-					std::vector< glm::u8vec4 > data(w*h);
-					glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-					for (auto &px : data) {
-						px.a = 0xff;
+				if (frame_up_to_date()) {
+					//sleep through idle time -- waking every MaxElapsed, so it still counts down at the usual rate:
+					wait = std::max(wait, std::min(Mode::current->idle_for(), MaxElapsed));
+				}
+				auto wait_until = std::chrono::high_resolution_clock::now() + std::chrono::duration< float >(wait);
+				while (Mode::current) {
+					float left = std::chrono::duration< float >(wait_until - std::chrono::high_resolution_clock::now()).count();
+					if (left <= 0.0f) break;
+					if (SDL_WaitEventTimeout(&evt, std::max(1, int(left * 1000.0f))) == 1) {
+						handle_event(evt);
+						//(in the foreground, respond right away; in the background, keep to the frame limit)
+						if (power.focused) break;
 					}
-					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
 				}
 			}
+			while (SDL_PollEvent(&evt) == 1) {
+				handle_event(evt);
+			}
 			if (!Mode::current) break;
+			if (!headless.enabled && power.minimized) continue;
 		}
 
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
@@ -151,24 +381,102 @@ int main(int argc, char **argv) {
 
 			//if frames are taking a very long time to process,
 			//lag to avoid spiral of death:
-			elapsed = std::min(0.1f, elapsed);
+			elapsed = std::min(MaxElapsed, elapsed);
+
+			//headless runs take fixed steps, so they draw the same frames every time:
+			if (headless.enabled) elapsed = 1.0f / 60.0f;
 
 			Mode::current->update(elapsed);
 			if (!Mode::current) break;
 		}
 
+		//nothing changed since the last frame? then it can stay on screen:
+		if (frame_up_to_date()) continue;
+
 		{ //(3) call the current mode's "draw" function to produce output:
-		
-			Mode::current->draw(drawable_size);
+			//(first, upload a budgeted slice of any textures still streaming in)
+			TextureStreamer::shared->update();
+
+			Mode &mode = *Mode::current;
+
+			//with dynamic resolution on, everything draws into a smaller target that gets stretched over the output:
+			// (modes draw as if the drawable were render_size; the aspect ratio stays the same -- to within rounding -- so mappings from
+			//  window to clip coordinates -- like FoosballMode's clip_to_court -- don't change)
+			glm::uvec2 render_size = drawable_size;
+			GLint output_framebuffer = 0; //(the window, or headless_target)
+			if (scaler) {
+				glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output_framebuffer);
+				render_size = scaler->begin(drawable_size);
+			}
+
+			if (mode.idle_for() > 0.0f) {
+				//static screen -- draw the scene once, then just copy it:
+				GLint framebuffer = 0; //(the output, or the scaler's target)
+				glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+				if (!cached.valid || cached.mode != &mode || cached.change_count != mode.change_count || cached_frame->size != render_size) {
+					cached_frame->resize(render_size);
+					cached_frame->bind();
+					mode.draw(render_size);
+					glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+					glViewport(0, 0, render_size.x, render_size.y);
+					cached.valid = true;
+					cached.mode = &mode;
+					cached.change_count = mode.change_count;
+				}
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, cached_frame->framebuffer);
+				glBlitFramebuffer(0, 0, render_size.x, render_size.y, 0, 0, render_size.x, render_size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+				mode.draw_overlay(render_size);
+			} else {
+				cached.valid = false;
+				mode.draw(render_size);
+			}
+
+			if (scaler) scaler->end(GLuint(output_framebuffer), drawable_size);
+
+			power.redraw = false;
+			power.drawn_idle = (mode.idle_for() > 0.0f);
+			power.drawn_mode = &mode;
+			power.drawn_change_count = mode.change_count;
+			power.drawn_time = std::chrono::high_resolution_clock::now();
+		}
+
+		if (headless_target) {
+			//no window to show the frame in -- export it (if asked), and stop after enough frames:
+			frames_drawn += 1;
+			if (!headless.export_prefix.empty()) {
+				std::vector< glm::u8vec4 > data;
+				headless_target->read_pixels(&data);
+				force_alpha(data.data(), data.size());
+				std::ostringstream filename;
+				filename << headless.export_prefix << std::setw(4) << std::setfill('0') << (frames_drawn - 1) << ".png";
+				save_png(filename.str(), headless_target->size, data.data(), LowerLeftOrigin);
+			}
+			if (frames_drawn >= headless.frames) {
+				glFinish(); //(so the time includes the GPU finishing the last frame)
+				float seconds = std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - frames_begin).count();
+				std::cout << "Headless: drew " << frames_drawn << " frames at " << headless.size.x << "x" << headless.size.y
+					<< " in " << seconds * 1000.0f << "ms (" << seconds * 1000.0f / frames_drawn << "ms per frame"
+					<< (headless.export_prefix.empty() ? "" : ", including export") << ")." << std::endl;
+				Mode::set_current(nullptr);
+			}
+		} else {
+			//Wait until the recently-drawn frame is shown before doing it all again:
+			SDL_GL_SwapWindow(window);
 		}
 
-		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+		gl_state.end_frame();
 	}
 
 
 	//------------  teardown ------------
 
+	//(textures and framebuffers go before the context does)
+	TextureStreamer::shared.reset();
+	headless_target.reset();
+	cached_frame.reset();
+	scaler.reset();
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
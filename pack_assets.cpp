@@ -0,0 +1,138 @@
+//pack_assets builds a packfile (see Packfile.hpp) out of a list of files.
+// usage: pack_assets [--store] <out.pack> <root-directory> <file> [<file> ...] [--root <root-directory> <file> ...]
+// each file is stored under its path relative to the <root-directory> before it (with '/' separators);
+// entries are zlib-compressed when that saves at least 10%, unless --store is given.
+
+#include "Packfile.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+	std::vector< std::string > args(argv + 1, argv + argc);
+	bool store = false;
+	if (!args.empty() && args[0] == "--store") {
+		store = true;
+		args.erase(args.begin());
+	}
+	if (args.size() < 2) {
+		std::cerr << "usage: pack_assets [--store] <out.pack> <root-directory> <file> [<file> ...] [--root <root-directory> <file> ...]" << std::endl;
+		return 1;
+	}
+	std::string out_name = args[0];
+	std::string root;
+	auto set_root = [&root](std::string const &dir) {
+		root = dir;
+		std::replace(root.begin(), root.end(), '\\', '/');
+		if (!root.empty() && root.back() != '/') root += '/';
+	};
+	set_root(args[1]);
+
+	struct Input {
+		std::string name;
+		std::vector< uint8_t > data;
+		uint64_t size = 0;
+		uint32_t flags = 0;
+	};
+	std::vector< Input > inputs;
+	for (auto file = args.begin() + 2; file != args.end(); ++file) {
+		//(generated files, e.g. the sprite atlas, live under a different root than the asset directory)
+		if (*file == "--root" && file + 1 != args.end()) {
+			++file;
+			set_root(*file);
+			continue;
+		}
+		Input input;
+		input.name = *file;
+		std::replace(input.name.begin(), input.name.end(), '\\', '/');
+		if (input.name.compare(0, root.size(), root) == 0) {
+			input.name = input.name.substr(root.size());
+		} else {
+			std::cerr << "WARNING: '" << *file << "' is not inside '" << root << "'; storing by its full path." << std::endl;
+		}
+
+		std::ifstream in(*file, std::ios::binary);
+		if (!in) {
+			std::cerr << "Failed to open '" << *file << "'." << std::endl;
+			return 1;
+		}
+		input.data.assign(std::istreambuf_iterator< char >(in), std::istreambuf_iterator< char >());
+		input.size = input.data.size();
+
+		if (!store && !input.data.empty()) {
+			std::vector< uint8_t > compressed(compressBound(uLong(input.data.size())));
+			uLongf length = uLongf(compressed.size());
+			if (compress2(compressed.data(), &length, input.data.data(), uLong(input.data.size()), Z_BEST_COMPRESSION) == Z_OK
+			 && length * 10 <= input.data.size() * 9) {
+				compressed.resize(length);
+				input.data = std::move(compressed);
+				input.flags |= PackEntryCompressed;
+			}
+		}
+		inputs.emplace_back(std::move(input));
+	}
+	//sorted names make the output independent of argument order:
+	std::sort(inputs.begin(), inputs.end(), [](Input const &a, Input const &b) { return a.name < b.name; });
+	for (size_t i = 1; i < inputs.size(); ++i) {
+		if (inputs[i].name == inputs[i-1].name) {
+			std::cerr << "Two inputs are named '" << inputs[i].name << "'." << std::endl;
+			return 1;
+		}
+	}
+
+	//----- lay out file -----
+	PackHeader header;
+	std::memcpy(header.magic, "NESTPACK", 8);
+	header.version = PackVersion;
+	header.count = uint32_t(inputs.size());
+
+	std::vector< PackEntry > toc(inputs.size());
+	size_t at = sizeof(PackHeader) + toc.size() * sizeof(PackEntry);
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		toc[i].name_offset = uint32_t(at);
+		toc[i].name_length = uint32_t(inputs[i].name.size());
+		at += inputs[i].name.size();
+	}
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		at = (at + PackAlignment - 1) / PackAlignment * PackAlignment;
+		toc[i].offset = at;
+		toc[i].stored_size = inputs[i].data.size();
+		toc[i].size = inputs[i].size;
+		toc[i].flags = inputs[i].flags;
+		toc[i].reserved = 0;
+		at += inputs[i].data.size();
+	}
+
+	//----- write -----
+	std::ofstream out(out_name, std::ios::binary);
+	out.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	out.write(reinterpret_cast< char const * >(toc.data()), toc.size() * sizeof(PackEntry));
+	for (auto const &input : inputs) {
+		out.write(input.name.data(), input.name.size());
+	}
+	static char const zeros[PackAlignment] = { 0 };
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		size_t pos = size_t(out.tellp());
+		out.write(zeros, toc[i].offset - pos);
+		out.write(reinterpret_cast< char const * >(inputs[i].data.data()), inputs[i].data.size());
+	}
+	if (!out) {
+		std::cerr << "Failed to write '" << out_name << "'." << std::endl;
+		return 1;
+	}
+
+	size_t total = 0, stored = 0;
+	for (auto const &input : inputs) {
+		total += size_t(input.size);
+		stored += input.data.size();
+	}
+	std::cout << "Packed " << inputs.size() << " entries (" << total << " bytes, " << stored << " stored) into '" << out_name << "'." << std::endl;
+	return 0;
+}
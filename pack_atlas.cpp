@@ -0,0 +1,129 @@
+//pack_atlas packs a set of PNG images into one atlas image plus a table saying where each one went.
+// usage: pack_atlas <out.png> <out.atlas> <root-directory> [<image.png> ...]
+// each image is named by its path relative to <root-directory>, without the '.png';
+// a 1x1 white image named 'white' is always included, so flat-colored quads can share the atlas.
+//
+// The table (see SpriteAtlas.hpp) is text:
+//   atlas <width> <height>
+//   <name> <x> <y> <width> <height>      -- one line per image; pixels, lower-left origin
+// Each image is surrounded by a one-pixel border copied from its edges, so filtering never bleeds.
+
+#include "load_save_png.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+	if (argc < 4) {
+		std::cerr << "usage: pack_atlas <out.png> <out.atlas> <root-directory> [<image.png> ...]" << std::endl;
+		return 1;
+	}
+	std::string out_png = argv[1];
+	std::string out_table = argv[2];
+	std::string root = argv[3];
+	std::replace(root.begin(), root.end(), '\\', '/');
+	if (!root.empty() && root.back() != '/') root += '/';
+
+	struct Image {
+		std::string name;
+		glm::uvec2 size = glm::uvec2(0);
+		std::vector< glm::u8vec4 > data;
+		glm::uvec2 at = glm::uvec2(0); //lower-left corner in atlas (not counting border)
+	};
+	std::vector< Image > images;
+
+	images.emplace_back();
+	images.back().name = "white";
+	images.back().size = glm::uvec2(1);
+	images.back().data.assign(1, glm::u8vec4(0xff));
+
+	try {
+		for (int i = 4; i < argc; ++i) {
+			Image image;
+			image.name = argv[i];
+			std::replace(image.name.begin(), image.name.end(), '\\', '/');
+			if (image.name.compare(0, root.size(), root) == 0) image.name = image.name.substr(root.size());
+			if (image.name.size() > 4 && image.name.compare(image.name.size() - 4, 4, ".png") == 0) image.name.erase(image.name.size() - 4);
+			//(the table is whitespace-separated, so such a name would garble every line after it)
+			if (image.name.empty() || image.name.find_first_of(" \t\r\n\v\f") != std::string::npos) {
+				std::cerr << "Image '" << argv[i] << "' gives the name '" << image.name << "', which is empty or contains whitespace." << std::endl;
+				return 1;
+			}
+			load_png(argv[i], &image.size, &image.data, LowerLeftOrigin);
+			for (auto const &other : images) {
+				if (other.name == image.name) {
+					std::cerr << "Two images are named '" << image.name << "'." << std::endl;
+					return 1;
+				}
+			}
+			images.emplace_back(std::move(image));
+		}
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	//----- pack into shelves, tallest images first -----
+	const uint32_t border = 1;
+	std::vector< Image * > order;
+	uint64_t area = 0;
+	uint32_t widest = 0;
+	for (auto &image : images) {
+		order.emplace_back(&image);
+		area += uint64_t(image.size.x + 2 * border) * (image.size.y + 2 * border);
+		widest = std::max(widest, image.size.x + 2 * border);
+	}
+	std::stable_sort(order.begin(), order.end(), [](Image const *a, Image const *b) {
+		return a->size.y > b->size.y;
+	});
+
+	//width: a power of two around the square root of the area (but wide enough for every image):
+	uint32_t width = 1;
+	while (width < widest || uint64_t(width) * width < area) width *= 2;
+
+	uint32_t x = 0, y = 0, shelf_height = 0;
+	for (Image *image : order) {
+		glm::uvec2 padded = image->size + glm::uvec2(2 * border);
+		if (x + padded.x > width) {
+			x = 0;
+			y += shelf_height;
+			shelf_height = 0;
+		}
+		image->at = glm::uvec2(x + border, y + border);
+		x += padded.x;
+		shelf_height = std::max(shelf_height, padded.y);
+	}
+	uint32_t height = 1;
+	while (height < y + shelf_height) height *= 2;
+
+	//----- copy images (and their extruded borders) into the atlas -----
+	std::vector< glm::u8vec4 > atlas(size_t(width) * height, glm::u8vec4(0));
+	for (auto const &image : images) {
+		for (int32_t ty = -int32_t(border); ty < int32_t(image.size.y + border); ++ty) {
+			int32_t sy = std::max(0, std::min(int32_t(image.size.y) - 1, ty));
+			for (int32_t tx = -int32_t(border); tx < int32_t(image.size.x + border); ++tx) {
+				int32_t sx = std::max(0, std::min(int32_t(image.size.x) - 1, tx));
+				atlas[size_t(image.at.y + ty) * width + (image.at.x + tx)] = image.data[size_t(sy) * image.size.x + sx];
+			}
+		}
+	}
+
+	save_png(out_png, glm::uvec2(width, height), atlas.data(), LowerLeftOrigin);
+
+	std::ofstream table(out_table);
+	table << "atlas " << width << " " << height << "\n";
+	for (auto const &image : images) {
+		table << image.name << " " << image.at.x << " " << image.at.y << " " << image.size.x << " " << image.size.y << "\n";
+	}
+	if (!table) {
+		std::cerr << "Failed to write '" << out_table << "'." << std::endl;
+		return 1;
+	}
+
+	std::cout << "Packed " << images.size() << " images into a " << width << "x" << height << " atlas '" << out_png << "'." << std::endl;
+	return 0;
+}
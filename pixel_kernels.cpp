@@ -0,0 +1,365 @@
+#include "pixel_kernels.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define PIXEL_KERNELS_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		//MSVC will emit any intrinsic without special flags:
+		#define TARGET_SSE2
+		#define TARGET_AVX2
+	#else
+		#define TARGET_SSE2 __attribute__((target("sse2")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+//------------------ scalar ------------------
+
+static void force_alpha_scalar(glm::u8vec4 *pixels, size_t count, uint8_t alpha) {
+	for (size_t i = 0; i < count; ++i) {
+		pixels[i].a = alpha;
+	}
+}
+
+static void swap_rows_scalar(uint8_t *a, uint8_t *b, size_t bytes) {
+	std::swap_ranges(a, a + bytes, b);
+}
+
+static void swizzle_rgba_bgra_scalar(glm::u8vec4 *pixels, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		std::swap(pixels[i].r, pixels[i].b);
+	}
+}
+
+static inline uint8_t mul_div_255(uint32_t c, uint32_t a) {
+	uint32_t t = c * a + 128;
+	return uint8_t((t + (t >> 8)) >> 8);
+}
+
+static void premultiply_alpha_scalar(glm::u8vec4 *pixels, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		glm::u8vec4 &px = pixels[i];
+		px.r = mul_div_255(px.r, px.a);
+		px.g = mul_div_255(px.g, px.a);
+		px.b = mul_div_255(px.b, px.a);
+	}
+}
+
+static void expand_rgb_to_rgba_scalar(uint8_t const *rgb, glm::u8vec4 *rgba, size_t count, uint8_t alpha) {
+	for (size_t i = 0; i < count; ++i) {
+		rgba[i] = glm::u8vec4(rgb[3*i+0], rgb[3*i+1], rgb[3*i+2], alpha);
+	}
+}
+
+static void blend_over_scalar(glm::u8vec4 *pixels, size_t count, glm::u8vec4 const &color) {
+	uint32_t a = color.a;
+	//(the color's share is the same for every pixel, so compute it once -- +128 rounds, as in mul_div_255)
+	uint32_t src[4] = { color.r * a + 128, color.g * a + 128, color.b * a + 128, color.a * a + 128 };
+	for (size_t i = 0; i < count; ++i) {
+		glm::u8vec4 &px = pixels[i];
+		for (uint32_t c = 0; c < 4; ++c) {
+			uint32_t t = src[c] + px[c] * (255 - a);
+			px[c] = uint8_t((t + (t >> 8)) >> 8);
+		}
+	}
+}
+
+#ifdef PIXEL_KERNELS_X86
+//------------------ SSE2 (4 pixels at a time) ------------------
+
+TARGET_SSE2 static void force_alpha_sse2(glm::u8vec4 *pixels, size_t count, uint8_t alpha) {
+	__m128i keep = _mm_set1_epi32(0x00ffffff);
+	__m128i set = _mm_set1_epi32(int32_t(uint32_t(alpha) << 24));
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i *at = reinterpret_cast< __m128i * >(pixels + i);
+		_mm_storeu_si128(at, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(at), keep), set));
+	}
+	force_alpha_scalar(pixels + i, count - i, alpha);
+}
+
+TARGET_SSE2 static void swap_rows_sse2(uint8_t *a, uint8_t *b, size_t bytes) {
+	size_t i = 0;
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast< __m128i const * >(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast< __m128i const * >(b + i));
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(a + i), vb);
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(b + i), va);
+	}
+	swap_rows_scalar(a + i, b + i, bytes - i);
+}
+
+TARGET_SSE2 static void swizzle_rgba_bgra_sse2(glm::u8vec4 *pixels, size_t count) {
+	__m128i ga = _mm_set1_epi32(int32_t(0xff00ff00));
+	__m128i low = _mm_set1_epi32(0x000000ff);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i *at = reinterpret_cast< __m128i * >(pixels + i);
+		__m128i v = _mm_loadu_si128(at);
+		__m128i r_to_b = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+		__m128i b_to_r = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+		_mm_storeu_si128(at, _mm_or_si128(_mm_and_si128(v, ga), _mm_or_si128(r_to_b, b_to_r)));
+	}
+	swizzle_rgba_bgra_scalar(pixels + i, count - i);
+}
+
+//premultiply two pixels' worth of 16-bit channels:
+TARGET_SSE2 static inline __m128i premultiply_2_sse2(__m128i px16) {
+	//broadcast each pixel's alpha across its channels, but use 255 for the alpha channel itself:
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px16, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+	alpha = _mm_or_si128(_mm_and_si128(alpha, _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1)), _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(px16, alpha), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+//blend two pixels' worth of 16-bit channels; 'src' is color * a + 128 and 'inv' is 255 - a, per channel:
+// (everything fits in unsigned 16 bits: 255 * 255 + 128 < 65536)
+TARGET_SSE2 static inline __m128i blend_over_2_sse2(__m128i px16, __m128i src, __m128i inv) {
+	__m128i t = _mm_add_epi16(src, _mm_mullo_epi16(px16, inv));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+TARGET_SSE2 static void blend_over_sse2(glm::u8vec4 *pixels, size_t count, glm::u8vec4 const &color) {
+	uint16_t a = color.a;
+	__m128i src = _mm_set_epi16(
+		int16_t(color.a * a + 128), int16_t(color.b * a + 128), int16_t(color.g * a + 128), int16_t(color.r * a + 128),
+		int16_t(color.a * a + 128), int16_t(color.b * a + 128), int16_t(color.g * a + 128), int16_t(color.r * a + 128)
+	);
+	__m128i inv = _mm_set1_epi16(int16_t(255 - a));
+	__m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i *at = reinterpret_cast< __m128i * >(pixels + i);
+		__m128i v = _mm_loadu_si128(at);
+		__m128i lo = blend_over_2_sse2(_mm_unpacklo_epi8(v, zero), src, inv);
+		__m128i hi = blend_over_2_sse2(_mm_unpackhi_epi8(v, zero), src, inv);
+		_mm_storeu_si128(at, _mm_packus_epi16(lo, hi));
+	}
+	blend_over_scalar(pixels + i, count - i, color);
+}
+
+TARGET_SSE2 static void premultiply_alpha_sse2(glm::u8vec4 *pixels, size_t count) {
+	__m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i *at = reinterpret_cast< __m128i * >(pixels + i);
+		__m128i v = _mm_loadu_si128(at);
+		__m128i lo = premultiply_2_sse2(_mm_unpacklo_epi8(v, zero));
+		__m128i hi = premultiply_2_sse2(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128(at, _mm_packus_epi16(lo, hi));
+	}
+	premultiply_alpha_scalar(pixels + i, count - i);
+}
+
+//------------------ AVX2 (8 pixels at a time) ------------------
+
+TARGET_AVX2 static void force_alpha_avx2(glm::u8vec4 *pixels, size_t count, uint8_t alpha) {
+	__m256i keep = _mm256_set1_epi32(0x00ffffff);
+	__m256i set = _mm256_set1_epi32(int32_t(uint32_t(alpha) << 24));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i *at = reinterpret_cast< __m256i * >(pixels + i);
+		_mm256_storeu_si256(at, _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256(at), keep), set));
+	}
+	force_alpha_scalar(pixels + i, count - i, alpha);
+}
+
+TARGET_AVX2 static void swap_rows_avx2(uint8_t *a, uint8_t *b, size_t bytes) {
+	size_t i = 0;
+	for (; i + 32 <= bytes; i += 32) {
+		__m256i va = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(a + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(b + i));
+		_mm256_storeu_si256(reinterpret_cast< __m256i * >(a + i), vb);
+		_mm256_storeu_si256(reinterpret_cast< __m256i * >(b + i), va);
+	}
+	swap_rows_scalar(a + i, b + i, bytes - i);
+}
+
+TARGET_AVX2 static void swizzle_rgba_bgra_avx2(glm::u8vec4 *pixels, size_t count) {
+	__m256i shuffle = _mm256_setr_epi8(
+		2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15,
+		2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15
+	);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i *at = reinterpret_cast< __m256i * >(pixels + i);
+		_mm256_storeu_si256(at, _mm256_shuffle_epi8(_mm256_loadu_si256(at), shuffle));
+	}
+	swizzle_rgba_bgra_scalar(pixels + i, count - i);
+}
+
+TARGET_AVX2 static inline __m256i premultiply_4_avx2(__m256i px16) {
+	__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px16, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+	alpha = _mm256_or_si256(
+		_mm256_and_si256(alpha, _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1)),
+		_mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0)
+	);
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(px16, alpha), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+TARGET_AVX2 static void premultiply_alpha_avx2(glm::u8vec4 *pixels, size_t count) {
+	__m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i *at = reinterpret_cast< __m256i * >(pixels + i);
+		__m256i v = _mm256_loadu_si256(at);
+		//(unpack and pack both work within 128-bit lanes, so the pixel order comes back out unchanged)
+		__m256i lo = premultiply_4_avx2(_mm256_unpacklo_epi8(v, zero));
+		__m256i hi = premultiply_4_avx2(_mm256_unpackhi_epi8(v, zero));
+		_mm256_storeu_si256(at, _mm256_packus_epi16(lo, hi));
+	}
+	premultiply_alpha_scalar(pixels + i, count - i);
+}
+
+TARGET_AVX2 static void blend_over_avx2(glm::u8vec4 *pixels, size_t count, glm::u8vec4 const &color) {
+	uint16_t a = color.a;
+	int16_t r = int16_t(color.r * a + 128), g = int16_t(color.g * a + 128), b = int16_t(color.b * a + 128), al = int16_t(color.a * a + 128);
+	__m256i src = _mm256_set_epi16(al, b, g, r, al, b, g, r, al, b, g, r, al, b, g, r);
+	__m256i inv = _mm256_set1_epi16(int16_t(255 - a));
+	__m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i *at = reinterpret_cast< __m256i * >(pixels + i);
+		__m256i v = _mm256_loadu_si256(at);
+		//(unpack and pack both work within 128-bit lanes, so the pixel order comes back out unchanged)
+		__m256i lo = _mm256_add_epi16(src, _mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), inv));
+		__m256i hi = _mm256_add_epi16(src, _mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), inv));
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+		_mm256_storeu_si256(at, _mm256_packus_epi16(lo, hi));
+	}
+	blend_over_scalar(pixels + i, count - i, color);
+}
+
+TARGET_AVX2 static void expand_rgb_to_rgba_avx2(uint8_t const *rgb, glm::u8vec4 *rgba, size_t count, uint8_t alpha) {
+	//spread 12 bytes of RGB over 16 bytes of RGBA (0x80 => zero):
+	__m128i shuffle = _mm_setr_epi8(0,1,2,-128, 3,4,5,-128, 6,7,8,-128, 9,10,11,-128);
+	__m128i set = _mm_set1_epi32(int32_t(uint32_t(alpha) << 24));
+	size_t i = 0;
+	//each 16-byte load reads 4 bytes past the 4 pixels it uses, so stop while that is still in bounds:
+	for (; i + 6 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const * >(rgb + 3 * i));
+		_mm_storeu_si128(reinterpret_cast< __m128i * >(rgba + i), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), set));
+	}
+	expand_rgb_to_rgba_scalar(rgb + 3 * i, rgba + i, count - i, alpha);
+}
+#endif //PIXEL_KERNELS_X86
+
+//------------------ dispatch ------------------
+
+namespace {
+struct PixelKernels {
+	char const *isa = "scalar";
+	void (*force_alpha)(glm::u8vec4 *, size_t, uint8_t) = force_alpha_scalar;
+	void (*swap_rows)(uint8_t *, uint8_t *, size_t) = swap_rows_scalar;
+	void (*swizzle_rgba_bgra)(glm::u8vec4 *, size_t) = swizzle_rgba_bgra_scalar;
+	void (*premultiply_alpha)(glm::u8vec4 *, size_t) = premultiply_alpha_scalar;
+	void (*expand_rgb_to_rgba)(uint8_t const *, glm::u8vec4 *, size_t, uint8_t) = expand_rgb_to_rgba_scalar;
+	void (*blend_over)(glm::u8vec4 *, size_t, glm::u8vec4 const &) = blend_over_scalar;
+};
+
+#ifdef PIXEL_KERNELS_X86
+bool cpu_has_sse2() {
+	#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+	#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+	#endif
+}
+
+bool cpu_has_avx2() {
+	#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 0x6) != 0x6) return false; //OS must save ymm state
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+	#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+	#endif
+}
+#endif
+
+PixelKernels const &kernels() {
+	static PixelKernels const chosen = [](){
+		PixelKernels ret;
+		//PIXEL_KERNELS_ISA=scalar or =sse2 caps the instruction set (handy for testing/comparing):
+		char const *cap_env = std::getenv("PIXEL_KERNELS_ISA");
+		std::string cap = (cap_env ? cap_env : "");
+		(void)cap;
+		#ifdef PIXEL_KERNELS_X86
+		if (cap != "scalar" && cpu_has_sse2()) {
+			ret.isa = "sse2";
+			ret.force_alpha = force_alpha_sse2;
+			ret.swap_rows = swap_rows_sse2;
+			ret.swizzle_rgba_bgra = swizzle_rgba_bgra_sse2;
+			ret.premultiply_alpha = premultiply_alpha_sse2;
+			ret.blend_over = blend_over_sse2;
+			//(no SSE2 version of expand: without pshufb it isn't a win)
+			if (cap != "sse2" && cpu_has_avx2()) {
+				ret.isa = "avx2";
+				ret.force_alpha = force_alpha_avx2;
+				ret.swap_rows = swap_rows_avx2;
+				ret.swizzle_rgba_bgra = swizzle_rgba_bgra_avx2;
+				ret.premultiply_alpha = premultiply_alpha_avx2;
+				ret.expand_rgb_to_rgba = expand_rgb_to_rgba_avx2;
+				ret.blend_over = blend_over_avx2;
+			}
+		}
+		#endif
+		return ret;
+	}();
+	return chosen;
+}
+} //namespace
+
+//------------------ public interface ------------------
+
+void force_alpha(glm::u8vec4 *pixels, size_t count, uint8_t alpha) {
+	kernels().force_alpha(pixels, count, alpha);
+}
+
+void flip_vertical(glm::u8vec4 *pixels, glm::uvec2 const &size) {
+	auto swap_rows = kernels().swap_rows;
+	size_t row_bytes = size_t(size.x) * sizeof(glm::u8vec4);
+	uint8_t *bytes = reinterpret_cast< uint8_t * >(pixels);
+	for (uint32_t y = 0; y < size.y / 2; ++y) {
+		swap_rows(bytes + y * row_bytes, bytes + (size.y - 1 - y) * row_bytes, row_bytes);
+	}
+}
+
+void swizzle_rgba_bgra(glm::u8vec4 *pixels, size_t count) {
+	kernels().swizzle_rgba_bgra(pixels, count);
+}
+
+void premultiply_alpha(glm::u8vec4 *pixels, size_t count) {
+	kernels().premultiply_alpha(pixels, count);
+}
+
+void expand_rgb_to_rgba(uint8_t const *rgb, glm::u8vec4 *rgba, size_t count, uint8_t alpha) {
+	kernels().expand_rgb_to_rgba(rgb, rgba, count, alpha);
+}
+
+void blend_over(glm::u8vec4 *pixels, size_t count, glm::u8vec4 const &color) {
+	kernels().blend_over(pixels, count, color);
+}
+
+char const *pixel_kernels_isa() {
+	return kernels().isa;
+}
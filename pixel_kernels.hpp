@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Small, vectorized kernels for fixing up RGBA images (screenshots, captures, texture loads)
+ * and for software rendering.
+ * The widest instruction set available (AVX2, then SSE2, then plain C++) is picked at runtime.
+ */
+
+//set every pixel's alpha to 'alpha':
+void force_alpha(glm::u8vec4 *pixels, size_t count, uint8_t alpha = 0xff);
+
+//reverse the order of the rows of a size.x * size.y image, in place:
+void flip_vertical(glm::u8vec4 *pixels, glm::uvec2 const &size);
+
+//swap the red and blue channels (RGBA <-> BGRA), in place:
+void swizzle_rgba_bgra(glm::u8vec4 *pixels, size_t count);
+
+//multiply color channels by alpha (rounded exactly, as 'c * a / 255'), in place:
+void premultiply_alpha(glm::u8vec4 *pixels, size_t count);
+
+//expand 'count' packed RGB pixels to RGBA with constant 'alpha' (rgb and rgba must not overlap):
+void expand_rgb_to_rgba(uint8_t const *rgb, glm::u8vec4 *rgba, size_t count, uint8_t alpha = 0xff);
+
+//blend 'color' over 'count' pixels the way GL does with glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA)
+// (alpha included), i.e., 'c * a / 255 + p * (255 - a) / 255' with exact rounding, in place:
+void blend_over(glm::u8vec4 *pixels, size_t count, glm::u8vec4 const &color);
+
+//which implementation is in use ("avx2", "sse2", or "scalar"):
+char const *pixel_kernels_isa();
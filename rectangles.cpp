@@ -0,0 +1,78 @@
+#include "rectangles.hpp"
+
+#include "GLStateCache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+void append_rectangle(Rectangle const &r, glm::vec2 const &extent, std::vector< RectangleVertex > *vertices_) {
+	assert(vertices_);
+	auto &vertices = *vertices_;
+	auto pack = [&extent](float x, float y) {
+		return glm::i16vec2(
+			int16_t(std::round(std::max(-1.0f, std::min(1.0f, x / extent.x)) * 32767.0f)),
+			int16_t(std::round(std::max(-1.0f, std::min(1.0f, y / extent.y)) * 32767.0f))
+		);
+	};
+	//corners in CCW order (see bind_rectangle_indices):
+	vertices.emplace_back(pack(r.center.x-r.radius.x, r.center.y-r.radius.y), r.color);
+	vertices.emplace_back(pack(r.center.x+r.radius.x, r.center.y-r.radius.y), r.color);
+	vertices.emplace_back(pack(r.center.x+r.radius.x, r.center.y+r.radius.y), r.color);
+	vertices.emplace_back(pack(r.center.x-r.radius.x, r.center.y+r.radius.y), r.color);
+}
+
+glm::mat4 rectangle_vertex_to_object(glm::vec2 const &extent) {
+	return glm::mat4(
+		glm::vec4(extent.x, 0.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, extent.y, 0.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+	);
+}
+
+void rectangle_vertex_attribs(ColorTextureProgram const &program) {
+	glVertexAttribPointer(
+		program.Position_vec4, //attribute
+		2, //size
+		GL_SHORT, //type
+		GL_TRUE, //normalized
+		sizeof(RectangleVertex), //stride
+		(GLbyte *)0 + 0 //offset
+	);
+	glEnableVertexAttribArray(program.Position_vec4);
+	//[Note that it is okay to bind a vec2 input to a vec4 attribute -- z and w will be filled with 0.0 and 1.0 automatically]
+
+	glVertexAttribPointer(
+		program.Color_vec4, //attribute
+		4, //size
+		GL_UNSIGNED_BYTE, //type
+		GL_TRUE, //normalized
+		sizeof(RectangleVertex), //stride
+		(GLbyte *)0 + 2*2 //offset
+	);
+	glEnableVertexAttribArray(program.Color_vec4);
+}
+
+void bind_rectangle_indices(size_t count) {
+	//NOTE: shared by every vertex array that draws rectangles, and never deleted (it goes away with the context):
+	static GLuint index_buffer = 0;
+	static size_t capacity = 0; //rectangles
+
+	if (index_buffer == 0) glGenBuffers(1, &index_buffer);
+	gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+
+	if (count > capacity) {
+		capacity = std::max< size_t >(1024, capacity);
+		while (capacity < count) capacity *= 2;
+		std::vector< uint32_t > indices;
+		indices.reserve(capacity * RectangleIndices);
+		for (uint32_t r = 0; r < capacity; ++r) {
+			uint32_t v = r * RectangleVertices;
+			for (uint32_t i : { 0, 1, 2, 0, 2, 3 }) {
+				indices.emplace_back(v + i);
+			}
+		}
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Rectangle.hpp"
+#include "ColorTextureProgram.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+//Compact (8-byte) vertices used to draw rectangles as indexed triangles:
+// Position is stored relative to an 'extent' -- that is, as position / extent in [-1,1], in normalized
+// shorts -- so the program's OBJECT_TO_COURT should be rectangle_vertex_to_object(extent).
+// (TexCoord isn't stored: every rectangle is a flat color, and textured variants will see a constant)
+struct RectangleVertex {
+	RectangleVertex(glm::i16vec2 const &Position_, glm::u8vec4 const &Color_) :
+		Position(Position_), Color(Color_) { }
+	glm::i16vec2 Position;
+	glm::u8vec4 Color;
+};
+static_assert(sizeof(RectangleVertex) == 2*2 + 1*4, "RectangleVertex should be packed");
+
+//each rectangle is four vertices, drawn as two CCW-oriented triangles using six indices:
+constexpr uint32_t RectangleVertices = 4;
+constexpr uint32_t RectangleIndices = 6;
+
+//append a rectangle's corners to 'vertices', with positions relative to 'extent':
+// (anything past +/-extent is clamped to it)
+void append_rectangle(Rectangle const &rectangle, glm::vec2 const &extent, std::vector< RectangleVertex > *vertices);
+
+//matrix that takes vertex positions stored relative to 'extent' back to object space:
+glm::mat4 rectangle_vertex_to_object(glm::vec2 const &extent);
+
+//point 'program's attributes at RectangleVertex data in the currently-bound GL_ARRAY_BUFFER:
+// (call with the vertex array object being set up bound)
+void rectangle_vertex_attribs(ColorTextureProgram const &program);
+
+//bind (as the GL_ELEMENT_ARRAY_BUFFER of the currently-bound vertex array object) a shared, static buffer
+// of GL_UNSIGNED_INT indices for at least 'count' rectangles' worth of vertices, growing it if needed:
+void bind_rectangle_indices(size_t count);
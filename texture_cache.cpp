@@ -0,0 +1,164 @@
+#include "texture_cache.hpp"
+
+#include "cache_files.hpp"
+#include "content_hash.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+std::string texture_cache_directory = "texture-cache";
+
+//Cache file layout: this header, then each level's pixels (tightly packed, largest first).
+struct TextureCacheHeader {
+	char magic[8]; //"TEXCACHE"
+	uint32_t version;
+	uint32_t origin; //OriginLocation
+	uint64_t source_hash;
+	uint64_t source_size;
+	uint32_t width, height;
+	uint32_t levels;
+	uint32_t reserved[5];
+};
+static_assert(sizeof(TextureCacheHeader) == 64, "cache header is packed");
+static constexpr uint32_t TextureCacheVersion = 1;
+
+static std::vector< glm::uvec2 > level_sizes(glm::uvec2 size, bool with_mips) {
+	std::vector< glm::uvec2 > ret;
+	ret.emplace_back(size);
+	while (with_mips && (size.x > 1 || size.y > 1)) {
+		size = glm::uvec2(std::max(1U, size.x / 2), std::max(1U, size.y / 2));
+		ret.emplace_back(size);
+	}
+	return ret;
+}
+
+//2x2 box filter (the last row/column is repeated when the source size is odd):
+static void downsample(glm::uvec2 const &src_size, glm::u8vec4 const *src, glm::uvec2 const &dst_size, glm::u8vec4 *dst) {
+	for (uint32_t y = 0; y < dst_size.y; ++y) {
+		uint32_t y0 = std::min(src_size.y - 1, 2 * y);
+		uint32_t y1 = std::min(src_size.y - 1, 2 * y + 1);
+		for (uint32_t x = 0; x < dst_size.x; ++x) {
+			uint32_t x0 = std::min(src_size.x - 1, 2 * x);
+			uint32_t x1 = std::min(src_size.x - 1, 2 * x + 1);
+			glm::u8vec4 const &a = src[y0 * src_size.x + x0];
+			glm::u8vec4 const &b = src[y0 * src_size.x + x1];
+			glm::u8vec4 const &c = src[y1 * src_size.x + x0];
+			glm::u8vec4 const &d = src[y1 * src_size.x + x1];
+			glm::u8vec4 &out = dst[y * dst_size.x + x];
+			for (uint32_t ch = 0; ch < 4; ++ch) {
+				out[ch] = uint8_t((uint32_t(a[ch]) + b[ch] + c[ch] + d[ch] + 2) / 4);
+			}
+		}
+	}
+}
+
+//check a mapped cache entry against what we expect; on success, point image->levels into it:
+static bool use_entry(MappedFile &&mapped, uint64_t source_hash, uint64_t source_size, OriginLocation origin, bool with_mips, CachedImage *image) {
+	TextureCacheHeader header;
+	if (mapped.size() < sizeof(header)) return false;
+	std::memcpy(&header, mapped.data(), sizeof(header));
+	if (std::memcmp(header.magic, "TEXCACHE", 8) != 0
+	 || header.version != TextureCacheVersion
+	 || header.origin != uint32_t(origin)
+	 || header.source_hash != source_hash
+	 || header.source_size != source_size) {
+		return false;
+	}
+	std::vector< glm::uvec2 > sizes = level_sizes(glm::uvec2(header.width, header.height), with_mips);
+	if (header.levels != sizes.size()) return false;
+	size_t offset = sizeof(header);
+	image->levels.clear();
+	for (auto const &size : sizes) {
+		image->levels.emplace_back();
+		image->levels.back().size = size;
+		image->levels.back().pixels = reinterpret_cast< glm::u8vec4 const * >(mapped.data() + offset);
+		offset += size_t(size.x) * size.y * sizeof(glm::u8vec4);
+	}
+	if (offset != mapped.size()) {
+		image->levels.clear();
+		return false;
+	}
+	image->mapped = std::move(mapped);
+	image->decoded.clear();
+	image->from_cache = true;
+	return true;
+}
+
+void load_png_cached(std::string const &filename, OriginLocation origin, bool with_mips, CachedImage *image) {
+	MappedFile source;
+	try {
+		source = MappedFile(filename);
+	} catch (std::exception &) {
+		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
+	}
+	load_png_cached(source.data(), source.size(), filename, origin, with_mips, image);
+}
+
+void load_png_cached(uint8_t const *bytes, size_t length, std::string const &name, OriginLocation origin, bool with_mips, CachedImage *image) {
+	assert(image);
+	*image = CachedImage();
+
+	uint64_t source_hash = content_hash(bytes, length);
+
+	std::string entry;
+	if (!texture_cache_directory.empty()) {
+		entry = texture_cache_directory + "/" + content_hash_hex(source_hash)
+			+ (origin == LowerLeftOrigin ? "-ll" : "-ul") + (with_mips ? "-mips" : "") + ".rgba";
+
+		//----- hit? -----
+		MappedFile mapped;
+		try {
+			mapped = MappedFile(entry);
+		} catch (std::exception &) {
+			//no entry yet
+		}
+		if (mapped.data() && use_entry(std::move(mapped), source_hash, length, origin, with_mips, image)) {
+			return;
+		}
+	}
+
+	//----- miss: decode (and build mips) -----
+	glm::uvec2 size = png_size(bytes, length);
+	std::vector< glm::uvec2 > sizes = level_sizes(size, with_mips);
+	size_t total = 0;
+	for (auto const &s : sizes) total += size_t(s.x) * s.y;
+	image->decoded.resize(total);
+	try {
+		load_png(bytes, length, &size, image->decoded.data(), size_t(size.x) * size.y, origin);
+	} catch (std::exception &) {
+		throw std::runtime_error("Failed to read PNG image from '" + name + "'.");
+	}
+	size_t offset = 0;
+	for (uint32_t l = 0; l < sizes.size(); ++l) {
+		if (l > 0) {
+			downsample(sizes[l-1], image->levels.back().pixels, sizes[l], image->decoded.data() + offset);
+		}
+		image->levels.emplace_back();
+		image->levels.back().size = sizes[l];
+		image->levels.back().pixels = image->decoded.data() + offset;
+		offset += size_t(sizes[l].x) * sizes[l].y;
+	}
+	image->from_cache = false;
+
+	//----- populate the cache -----
+	if (entry.empty()) return;
+
+	TextureCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "TEXCACHE", 8);
+	header.version = TextureCacheVersion;
+	header.origin = uint32_t(origin);
+	header.source_hash = source_hash;
+	header.source_size = length;
+	header.width = size.x;
+	header.height = size.y;
+	header.levels = uint32_t(sizes.size());
+
+	make_cache_directory(texture_cache_directory);
+	write_cache_file(entry, {
+		{ &header, sizeof(header) },
+		{ image->decoded.data(), image->decoded.size() * sizeof(glm::u8vec4) },
+	});
+}
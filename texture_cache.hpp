@@ -0,0 +1,45 @@
+#pragma once
+
+#include "load_save_png.hpp"
+#include "MappedFile.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/*
+ * On-disk cache of decoded PNGs (optionally with their mip chains), so that warm starts
+ * skip decoding entirely and just map the already-decoded pixels.
+ *
+ * Entries are keyed by a hash of the PNG's bytes, so changing the source simply misses the cache.
+ * Entries are written to a temporary file and renamed into place, so processes populating the
+ * cache at the same time never see (or produce) a half-written entry.
+ */
+
+//Pixels (and mips) loaded by load_png_cached:
+struct CachedImage {
+	struct Level {
+		glm::uvec2 size = glm::uvec2(0);
+		glm::u8vec4 const *pixels = nullptr;
+	};
+	//levels[0] is the image itself; if mips were requested, each following level is
+	// half the size of the previous (rounded down, at least 1) down to 1x1:
+	std::vector< Level > levels;
+	bool from_cache = false; //was this a cache hit?
+
+	glm::uvec2 size() const { return levels.empty() ? glm::uvec2(0) : levels[0].size; }
+
+	//storage that 'levels' point into -- the mapped cache file on a hit, decoded data on a miss:
+	MappedFile mapped;
+	std::vector< glm::u8vec4 > decoded;
+};
+
+//Where cache entries live (created on first write); set to "" to turn caching off:
+extern std::string texture_cache_directory;
+
+//Like load_png, but served from the cache when possible; 'with_mips' also produces a box-filtered mip chain.
+//NOTE: throws on error, just like load_png. Failing to *write* the cache is only a warning.
+void load_png_cached(std::string const &filename, OriginLocation origin, bool with_mips, CachedImage *image);
+//...or from a PNG already in memory (e.g., a Packfile entry); 'name' is only used in error messages:
+void load_png_cached(uint8_t const *bytes, size_t length, std::string const &name, OriginLocation origin, bool with_mips, CachedImage *image);